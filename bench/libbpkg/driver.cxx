@@ -0,0 +1,387 @@
+// file      : bench/libbpkg/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <ios>       // ios_base::failbit, ios_base::badbit
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm> // find()
+#include <cstdint>   // uint64_t
+#include <cstddef>   // size_t
+#include <iostream>
+#include <exception>
+#include <functional>
+
+#include <libbutl/utility.hxx>             // operator<<(ostream, exception)
+#include <libbutl/manifest-parser.hxx>
+#include <libbutl/manifest-serializer.hxx>
+
+#include <libbpkg/version.hxx>
+#include <libbpkg/manifest.hxx>
+#include <libbpkg/buffer-stream.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace butl;
+using namespace bpkg;
+
+// Usage: argv[0] [--iterations <count>] [--packages <count>] [<name>...]
+//
+// Run the libbpkg benchmarks and print the results to stdout, one per line,
+// in the following machine-readable form:
+//
+// <name> <iterations> <operations> <total-ns> <ns-per-operation>
+//
+// Where <operations> is the number of benchmarked operations performed by
+// all the iterations (for example, the number of versions parsed), so that
+// the results for different iteration counts are comparable. The first line
+// is the libbpkg version in the following form:
+//
+// libbpkg <version>
+//
+// If benchmark names are specified, then only run these benchmarks.
+//
+// --iterations <count>
+//    Number of iterations for each benchmark, 100 by default.
+//
+// --packages <count>
+//    Number of packages in the synthetic repository used by the package
+//    manifest list load/serialize benchmarks, 1000 by default.
+//
+// Note that the input data is generated deterministically, so that the
+// results are reproducible between runs and libbpkg versions.
+//
+
+// Make sure the compiler doesn't optimize the benchmarked code away.
+//
+static volatile size_t sink;
+
+struct benchmark
+{
+  string name;
+
+  // Perform the benchmarked operations and return their number.
+  //
+  function<size_t ()> run;
+};
+
+static const char* sha256sum (
+  "b5b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+// Generate the synthetic package manifest list text.
+//
+static string
+package_list (size_t n)
+{
+  string r (": 1\nsha256sum: ");
+  r += sha256sum;
+  r += '\n';
+
+  for (size_t i (0); i != n; ++i)
+  {
+    string nm ("libfoo" + to_string (i / 4));
+    string v ("1." + to_string (i % 4) + ".0");
+
+    r += ":\n";
+    r += "name: " + nm + '\n';
+    r += "version: " + v + '\n';
+    r += "summary: The " + nm + " C++ library\n";
+    r += "license: MIT\n";
+    r += "description: \\\n";
+    r += nm + " is a synthetic package used for benchmarking.\n";
+    r += "It has a multi-line description.\n";
+    r += "\\\n";
+    r += "description-type: text/plain\n";
+    r += "url: https://example.org/" + nm + '\n';
+    r += "email: " + nm + "@example.org\n";
+    r += "depends: * build2 >= 0.16.0\n";
+
+    if (i >= 4)
+      r += "depends: libfoo" + to_string (i / 4 - 1) + " ^1.0.0\n";
+
+    r += "depends: libbar >= 1.2.0 | libbaz ~2.0.0\n";
+    r += "requires: c++14\n";
+    r += "builds: default : &gcc\n";
+    r += "bootstrap-build: \\\nproject = " + nm + "\n\\\n";
+    r += "location: " + nm + '/' + nm + '-' + v + ".tar.gz\n";
+    r += "sha256sum: ";
+    r += sha256sum;
+    r += '\n';
+  }
+
+  return r;
+}
+
+int
+main (int argc, char* argv[])
+try
+{
+  size_t iterations (100);
+  size_t packages (1000);
+  vector<string> names;
+
+  for (int i (1); i != argc; ++i)
+  {
+    string o (argv[i]);
+
+    if (o == "--iterations")
+    {
+      assert (i + 1 != argc);
+      iterations = stoul (argv[++i]);
+    }
+    else if (o == "--packages")
+    {
+      assert (i + 1 != argc);
+      packages = stoul (argv[++i]);
+    }
+    else
+      names.push_back (move (o));
+  }
+
+  // Prepare the input data.
+  //
+  vector<string> versions;
+  for (size_t i (0); i != 100; ++i)
+  {
+    string v (to_string (i % 3 + 1) + '.' + to_string (i % 7) + '.' +
+              to_string (i));
+
+    if (i % 5 == 0)
+      v += "-a." + to_string (i % 4);
+
+    if (i % 9 == 0)
+      v += '+' + to_string (i % 2 + 1);
+
+    versions.push_back (move (v));
+  }
+
+  vector<version> parsed_versions;
+  for (const string& v: versions)
+    parsed_versions.push_back (version (v));
+
+  const package_name dependent ("libfoo");
+  const vector<string> dependencies ({
+      "libbar ^1.2.0",
+      "libbar >= 1.2.0 | libbaz ~2.0.0",
+      "{libbar libbaz} [1.0.0 2.0.0)",
+      "libbar ? ($config.libfoo.bar)",
+      "libbar config.libfoo.bar=true",
+      "libbar\n{\n  enable ($cxx.target.class == 'windows')\n\n"
+      "  reflect\n  {\n    config.libfoo.bar=true\n  }\n}",
+      "{libbar libbaz} ^1.0.0 ? ($cxx.target.class == 'windows') | libbox"});
+
+  const build_class_inheritance_map inheritance ({
+      {"gcc", "default"}, {"clang", "default"}, {"msvc", "default"}});
+
+  const vector<build_class_expr> class_exprs ({
+      build_class_expr ("default", ""),
+      build_class_expr ("default : &gcc", ""),
+      build_class_expr ("all : -windows +( +linux &!gcc )", ""),
+      build_class_expr ("default legacy : -msvc", "")});
+
+  const vector<strings> config_classes ({
+      {"linux", "gcc"}, {"windows", "msvc"}, {"macos", "clang"}, {"legacy"}});
+
+  const vector<string> repository_urls ({
+      "https://pkg.cppget.org/1/stable",
+      "https://git.example.org/project.git#master",
+      "git+https://example.org/foo/bar#v1.2.0",
+      "http://www.example.org/1/math/testing",
+      "/var/bpkg/1/stable"});
+
+  // Synthetic git repository references and filters.
+  //
+  vector<git_ref> git_refs;
+  for (size_t i (0); i != 1000; ++i)
+  {
+    string c (sha256sum, 40);
+    c.replace (0, 4, to_string (1000 + i));
+
+    git_refs.push_back (
+      git_ref {i % 2 == 0
+               ? "refs/tags/v1." + to_string (i / 2) + ".0"
+               : "refs/heads/feature/f" + to_string (i / 2),
+               move (c)});
+  }
+
+  const git_ref_filter_matcher git_matcher (
+    parse_git_ref_filters (string ("#,feature/*,-feature/f1,master,-v1.2.0")));
+
+  const string list (package_list (packages));
+  const pkg_package_manifests loaded (
+    parse_manifest<pkg_package_manifests> (list.data (),
+                                           list.size (),
+                                           "list"));
+
+  vector<manifest_name_value> overrides;
+
+  auto add_override = [&overrides] (string n, string v)
+  {
+    manifest_name_value nv;
+    nv.name = move (n);
+    nv.value = move (v);
+    nv.name_line = nv.value_line = overrides.size () + 1;
+    nv.name_column = 1;
+    nv.value_column = nv.name.size () + 3;
+    nv.start_pos = nv.colon_pos = nv.end_pos = 0;
+
+    overrides.push_back (move (nv));
+  };
+
+  add_override ("builds", "all : &default");
+  add_override ("build-email", "builds@example.org");
+  add_override ("build-error-email", "errors@example.org");
+
+  const string overrides_name ("overrides");
+
+  vector<benchmark> benchmarks ({
+    {
+      "version-parse", [&versions] ()
+      {
+        for (const string& v: versions)
+          sink = version (v).canonical_upstream.size ();
+
+        return versions.size ();
+      }
+    },
+    {
+      "version-compare", [&parsed_versions] ()
+      {
+        size_t r (0);
+        for (const version& x: parsed_versions)
+          for (const version& y: parsed_versions)
+            r += x.compare (y) < 0;
+
+        sink = r;
+        return parsed_versions.size () * parsed_versions.size ();
+      }
+    },
+    {
+      "dependency-alternatives-parse", [&dependencies, &dependent] ()
+      {
+        for (const string& d: dependencies)
+          sink = dependency_alternatives (d, dependent).size ();
+
+        return dependencies.size ();
+      }
+    },
+    {
+      "build-class-expr-match", [&class_exprs, &config_classes, &inheritance] ()
+      {
+        size_t r (0);
+        for (const strings& cs: config_classes)
+        {
+          bool m (false);
+          for (const build_class_expr& e: class_exprs)
+            e.match (cs, inheritance, m);
+
+          r += m;
+        }
+
+        sink = r;
+        return config_classes.size () * class_exprs.size ();
+      }
+    },
+    {
+      "repository-location", [&repository_urls] ()
+      {
+        for (const string& u: repository_urls)
+          sink = repository_location (u).canonical_name ().size ();
+
+        return repository_urls.size ();
+      }
+    },
+    {
+      "repository-location-cache", [&repository_urls] ()
+      {
+        // Note that each location is interned repeatedly, as is normally
+        // the case for the prerequisite and complement repositories.
+        //
+        repository_location_cache c;
+        for (size_t i (0); i != 10; ++i)
+        {
+          for (const string& u: repository_urls)
+            sink = c.intern (u).canonical_name_hash ();
+        }
+
+        return repository_urls.size () * 10;
+      }
+    },
+    {
+      "git-ref-filter-match", [&git_refs, &git_matcher] ()
+      {
+        sink = git_matcher.match (git_refs).refs.size ();
+        return git_refs.size ();
+      }
+    },
+    {
+      "pkg-package-manifests-load", [&list, &loaded] ()
+      {
+        sink = parse_manifest<pkg_package_manifests> (list.data (),
+                                                      list.size (),
+                                                      "list").size ();
+        return loaded.size ();
+      }
+    },
+    {
+      "pkg-package-manifests-serialize", [&loaded] ()
+      {
+        string r;
+        obufferstream os (r);
+        os.exceptions (ios_base::failbit | ios_base::badbit);
+
+        manifest_serializer s (os, "list");
+        loaded.serialize (s);
+        os.flush ();
+
+        sink = r.size ();
+        return loaded.size ();
+      }
+    },
+    {
+      "package-manifest-override", [&loaded, &overrides, &overrides_name] ()
+      {
+        package_manifest m (loaded.front ());
+        m.override (overrides, overrides_name);
+
+        sink = m.builds.size ();
+        return size_t (1);
+      }
+    }});
+
+  cout << "libbpkg " << LIBBPKG_VERSION_STR << endl;
+
+  for (const benchmark& b: benchmarks)
+  {
+    if (!names.empty () &&
+        find (names.begin (), names.end (), b.name) == names.end ())
+      continue;
+
+    // Warm up.
+    //
+    b.run ();
+
+    using namespace chrono;
+
+    size_t ops (0);
+    steady_clock::time_point start (steady_clock::now ());
+
+    for (size_t i (0); i != iterations; ++i)
+      ops += b.run ();
+
+    uint64_t ns (duration_cast<nanoseconds> (
+                   steady_clock::now () - start).count ());
+
+    cout << b.name << ' ' << iterations << ' ' << ops << ' ' << ns << ' '
+         << (ops != 0 ? ns / ops : 0) << endl;
+  }
+
+  return 0;
+}
+catch (const exception& e)
+{
+  cerr << e << endl;
+  return 1;
+}
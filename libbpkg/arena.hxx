@@ -0,0 +1,219 @@
+// file      : libbpkg/arena.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef LIBBPKG_ARENA_HXX
+#define LIBBPKG_ARENA_HXX
+
+#include <new>         // operator new(), bad_alloc
+#include <cstddef>     // size_t, max_align_t
+#include <cstdint>     // uintptr_t
+#include <cassert>
+#include <utility>     // move(), swap()
+#include <type_traits> // true_type
+
+namespace bpkg
+{
+  // Monotonic memory arena.
+  //
+  // The memory is allocated from large blocks which are only released all
+  // at once, when the arena is destroyed, and individual deallocations are
+  // no-ops. Normally, the arena is provided by the caller when loading a
+  // large number of manifests (see lazy_pkg_package_manifests for an
+  // example) which are then released together with the arena. This way
+  // both the loading and the teardown avoid a large number of small heap
+  // allocations and deallocations.
+  //
+  // Note that the arena must outlive all the objects allocated from it and
+  // is not thread-safe.
+  //
+  class manifest_arena
+  {
+  public:
+    // The minimum size of the blocks the memory is allocated from. A larger
+    // block is allocated for a larger request.
+    //
+    explicit
+    manifest_arena (std::size_t block_size = 64 * 1024)
+        : block_size_ (block_size) {}
+
+    ~manifest_arena ()
+    {
+      for (block* b (head_); b != nullptr; )
+      {
+        block* n (b->next);
+        ::operator delete (b);
+        b = n;
+      }
+    }
+
+    manifest_arena (manifest_arena&& a)
+        : block_size_ (a.block_size_),
+          head_ (a.head_),
+          pos_ (a.pos_),
+          end_ (a.end_),
+          allocated_ (a.allocated_)
+    {
+      a.head_ = nullptr;
+      a.pos_ = a.end_ = nullptr;
+      a.allocated_ = 0;
+    }
+
+    manifest_arena&
+    operator= (manifest_arena&& a)
+    {
+      if (this != &a)
+      {
+        manifest_arena t (std::move (a));
+        swap (t);
+      }
+
+      return *this;
+    }
+
+    manifest_arena (const manifest_arena&) = delete;
+    manifest_arena& operator= (const manifest_arena&) = delete;
+
+    // Allocate the memory of the specified size and alignment. Throw
+    // bad_alloc if unable to allocate a new block.
+    //
+    void*
+    allocate (std::size_t n, std::size_t align = alignof (std::max_align_t))
+    {
+      assert ((align & (align - 1)) == 0); // Power of 2.
+
+      char* p (align_up (pos_, align));
+
+      if (p == nullptr || n > static_cast<std::size_t> (end_ - p))
+      {
+        add_block (n + align);
+        p = align_up (pos_, align);
+      }
+
+      pos_ = p + n;
+      allocated_ += n;
+      return p;
+    }
+
+    // Total number of bytes allocated from the arena so far.
+    //
+    std::size_t
+    allocated () const {return allocated_;}
+
+    void
+    swap (manifest_arena& a)
+    {
+      std::swap (block_size_, a.block_size_);
+      std::swap (head_, a.head_);
+      std::swap (pos_, a.pos_);
+      std::swap (end_, a.end_);
+      std::swap (allocated_, a.allocated_);
+    }
+
+  private:
+    struct block
+    {
+      block* next;
+    };
+
+    static char*
+    align_up (char* p, std::size_t a)
+    {
+      if (p == nullptr)
+        return nullptr;
+
+      std::size_t r (reinterpret_cast<std::uintptr_t> (p) & (a - 1));
+      return r != 0 ? p + (a - r) : p;
+    }
+
+    void
+    add_block (std::size_t n)
+    {
+      std::size_t s (sizeof (block) + (n > block_size_ ? n : block_size_));
+
+      block* b (static_cast<block*> (::operator new (s)));
+      b->next = head_;
+      head_ = b;
+
+      pos_ = reinterpret_cast<char*> (b) + sizeof (block);
+      end_ = reinterpret_cast<char*> (b) + s;
+    }
+
+  private:
+    std::size_t block_size_;
+    block*      head_ = nullptr;
+    char*       pos_ = nullptr;
+    char*       end_ = nullptr;
+    std::size_t allocated_ = 0;
+  };
+
+  // Allocator which allocates the memory from the arena, if specified, and
+  // from the heap otherwise. This allows to use the same container type for
+  // both the arena-allocated and the regular objects.
+  //
+  // Note that the container copies are allocated from the heap (see
+  // select_on_container_copy_construction()) so that they don't depend on
+  // the arena lifetime. The moved-to containers, however, keep allocating
+  // from the source container's arena.
+  //
+  template <typename T>
+  class arena_allocator
+  {
+  public:
+    using value_type = T;
+
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    arena_allocator () = default;
+
+    explicit
+    arena_allocator (manifest_arena* a): arena_ (a) {}
+
+    template <typename U>
+    arena_allocator (const arena_allocator<U>& a): arena_ (a.arena ()) {}
+
+    T*
+    allocate (std::size_t n)
+    {
+      return static_cast<T*> (
+        arena_ != nullptr
+        ? arena_->allocate (n * sizeof (T), alignof (T))
+        : ::operator new (n * sizeof (T)));
+    }
+
+    void
+    deallocate (T* p, std::size_t) noexcept
+    {
+      if (arena_ == nullptr)
+        ::operator delete (p);
+    }
+
+    arena_allocator
+    select_on_container_copy_construction () const
+    {
+      return arena_allocator ();
+    }
+
+    manifest_arena*
+    arena () const {return arena_;}
+
+  private:
+    manifest_arena* arena_ = nullptr;
+  };
+
+  template <typename T, typename U>
+  inline bool
+  operator== (const arena_allocator<T>& x, const arena_allocator<U>& y)
+  {
+    return x.arena () == y.arena ();
+  }
+
+  template <typename T, typename U>
+  inline bool
+  operator!= (const arena_allocator<T>& x, const arena_allocator<U>& y)
+  {
+    return !(x == y);
+  }
+}
+
+#endif // LIBBPKG_ARENA_HXX
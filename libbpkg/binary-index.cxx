@@ -0,0 +1,262 @@
+// file      : libbpkg/binary-index.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <libbpkg/binary-index.hxx>
+
+#include <string>
+#include <limits>
+#include <cstring>       // memcmp()
+#include <unordered_map>
+
+#include <libbutl/manifest-parser.hxx>
+#include <libbutl/manifest-serializer.hxx>
+
+#include <libbpkg/buffer-stream.hxx>
+
+using namespace std;
+using namespace butl;
+
+namespace bpkg
+{
+  static const char magic[8] = {'b', 'p', 'k', 'g', 'i', 'd', 'x', '\n'};
+
+  // Header: magic, format version, package count, strings offset and size,
+  // and two checksum references.
+  //
+  static const size_t header_size = sizeof (magic) + 8 * 4;
+
+  // Package record: six string references.
+  //
+  static const size_t record_size = 6 * 2 * 4;
+
+  static inline uint32_t
+  get (const char* p) noexcept
+  {
+    const unsigned char* u (reinterpret_cast<const unsigned char*> (p));
+
+    return static_cast<uint32_t> (u[0])       |
+           static_cast<uint32_t> (u[1]) << 8  |
+           static_cast<uint32_t> (u[2]) << 16 |
+           static_cast<uint32_t> (u[3]) << 24;
+  }
+
+  static inline void
+  put (string& s, uint32_t v)
+  {
+    s += static_cast<char> (v         & 0xFF);
+    s += static_cast<char> ((v >> 8)  & 0xFF);
+    s += static_cast<char> ((v >> 16) & 0xFF);
+    s += static_cast<char> ((v >> 24) & 0xFF);
+  }
+
+  static inline bool
+  valid (const char* p, size_t n) noexcept
+  {
+    uint32_t o (get (p));
+    uint32_t s (get (p + 4));
+    return o <= n && s <= n - o;
+  }
+
+  // binary_package_index
+  //
+  binary_package_index::
+  binary_package_index (const char* d, size_t n)
+      : data_ (d)
+  {
+    auto bad = [] (const char* what)
+    {
+      throw invalid_argument (string ("invalid binary package index: ") +
+                              what);
+    };
+
+    if (n < header_size || memcmp (d, magic, sizeof (magic)) != 0)
+      bad ("no header");
+
+    const char* h (d + sizeof (magic));
+
+    if (get (h) != format_version)
+      bad ("unsupported format version");
+
+    size_ = get (h + 4);
+
+    uint32_t so (get (h + 8));
+    uint32_t ss (get (h + 12));
+
+    if (so > n || ss > n - so)
+      bad ("string table out of bounds");
+
+    if (so < header_size || size_ > (so - header_size) / record_size)
+      bad ("package records out of bounds");
+
+    packages_ = d + header_size;
+    strings_  = d + so;
+
+    if (!valid (h + 16, ss) || !valid (h + 24, ss))
+      bad ("checksum out of bounds");
+
+    for (size_t i (0); i != size_; ++i)
+    {
+      const char* r (packages_ + i * record_size);
+
+      for (size_t j (0); j != 6; ++j)
+      {
+        if (!valid (r + j * 8, ss))
+          bad ("package record field out of bounds");
+      }
+    }
+  }
+
+  binary_package_index::package binary_package_index::
+  operator[] (size_t i) const noexcept
+  {
+    const char* r (packages_ + i * record_size);
+
+    auto field = [r, this] (size_t j) -> string_ref
+    {
+      const char* f (r + j * 8);
+      return string_ref {strings_ + get (f), get (f + 4)};
+    };
+
+    return package {
+      field (0), field (1), field (2), field (3), field (4), field (5)};
+  }
+
+  binary_package_index::string_ref binary_package_index::
+  sha256sum () const noexcept
+  {
+    const char* f (data_ + sizeof (magic) + 16);
+    return string_ref {strings_ + get (f), get (f + 4)};
+  }
+
+  binary_package_index::string_ref binary_package_index::
+  source_sha256sum () const noexcept
+  {
+    const char* f (data_ + sizeof (magic) + 24);
+    return string_ref {strings_ + get (f), get (f + 4)};
+  }
+
+  package_manifest binary_package_index::
+  manifest (size_t i, bool iu) const
+  {
+    string_ref m ((*this)[i].manifest);
+
+    ibufferstream is (m.data, m.size);
+    is.exceptions (ios_base::failbit | ios_base::badbit);
+
+    manifest_parser p (is, "binary package index");
+    package_manifest r (pkg_package_manifest (p, p.next (), iu));
+
+    // Make sure this is the end.
+    //
+    manifest_name_value nv (p.next ());
+    if (!nv.empty ())
+      throw manifest_parsing (p.name (), nv.name_line, nv.name_column,
+                              "single package manifest expected");
+
+    return r;
+  }
+
+  pkg_package_manifests binary_package_index::
+  manifests (bool iu) const
+  {
+    pkg_package_manifests r;
+    r.sha256sum = sha256sum ().string ();
+
+    r.reserve (size_);
+    for (size_t i (0); i != size_; ++i)
+      r.push_back (manifest (i, iu));
+
+    return r;
+  }
+
+  // serialize_binary_package_index()
+  //
+  string
+  serialize_binary_package_index (const pkg_package_manifests& ms,
+                                  const string& ssum)
+  {
+    // Build the string table, sharing identical strings (package names,
+    // etc), except for the serialized manifests which are always unique.
+    //
+    string strings;
+    unordered_map<string, uint32_t> offsets;
+
+    auto check = [] (size_t n)
+    {
+      if (n > numeric_limits<uint32_t>::max ())
+        throw invalid_argument ("binary package index is too large");
+    };
+
+    string refs; // String references in the header and records order.
+
+    auto add = [&strings, &refs, &check] (const char* s, size_t n)
+    {
+      check (strings.size () + n);
+
+      put (refs, static_cast<uint32_t> (strings.size ()));
+      put (refs, static_cast<uint32_t> (n));
+
+      strings.append (s, n);
+    };
+
+    auto add_shared = [&strings, &offsets, &refs, &add] (const string& s)
+    {
+      auto i (offsets.find (s));
+      if (i != offsets.end ())
+      {
+        put (refs, i->second);
+        put (refs, static_cast<uint32_t> (s.size ()));
+      }
+      else
+      {
+        uint32_t o (static_cast<uint32_t> (strings.size ()));
+        add (s.c_str (), s.size ());
+        offsets.emplace (s, o);
+      }
+    };
+
+    add_shared (ms.sha256sum);
+    add_shared (ssum);
+
+    // Serialize the package manifests into the same reusable buffer.
+    //
+    string m;
+
+    for (const package_manifest& pm: ms)
+    {
+      add_shared (pm.name.string ());
+      add_shared (pm.version.string ());
+      add_shared (pm.version.compare_key ().data ());
+      add_shared (pm.location ? pm.location->string () : string ());
+      add_shared (pm.sha256sum ? *pm.sha256sum : string ());
+
+      m.clear ();
+      {
+        obufferstream os (m);
+        os.exceptions (ios_base::failbit | ios_base::badbit);
+
+        manifest_serializer s (os, "binary package index");
+        pkg_package_manifest (s, pm);
+        s.next ("", ""); // End of stream.
+      }
+
+      add (m.data (), m.size ());
+    }
+
+    size_t so (header_size + ms.size () * record_size);
+    check (so + strings.size ());
+
+    string r;
+    r.reserve (so + strings.size ());
+
+    r.append (magic, sizeof (magic));
+    put (r, binary_package_index::format_version);
+    put (r, static_cast<uint32_t> (ms.size ()));
+    put (r, static_cast<uint32_t> (so));
+    put (r, static_cast<uint32_t> (strings.size ()));
+    r += refs;
+    r += strings;
+
+    return r;
+  }
+}
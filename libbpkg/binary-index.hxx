@@ -0,0 +1,161 @@
+// file      : libbpkg/binary-index.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef LIBBPKG_BINARY_INDEX_HXX
+#define LIBBPKG_BINARY_INDEX_HXX
+
+#include <string>
+#include <cstdint>   // uint32_t
+#include <cstddef>   // size_t
+#include <cstring>   // memcmp()
+#include <stdexcept> // invalid_argument
+
+#include <libbpkg/manifest.hxx>
+
+#include <libbpkg/export.hxx>
+
+namespace bpkg
+{
+  // Precompiled (binary) representation of the pkg package manifest list
+  // (packages.manifest).
+  //
+  // The index is produced from the parsed package manifest list once (for
+  // example, when the repository is created or fetched) and can then be
+  // used directly from memory (memory-mapped file, file contents read in a
+  // single system call, etc) without any parsing or allocations. This makes
+  // it suitable for operations that need to quickly scan the package list
+  // (listing, searching, dependency resolution, etc) and only occasionally
+  // need the complete package manifest, which is parsed on request from the
+  // serialized text stored in the index.
+  //
+  // The index has the following layout with all the integers stored as
+  // little-endian uint32 values:
+  //
+  // <magic>              8 bytes, "bpkgidx\n"
+  // <format-version>     currently 1
+  // <package-count>
+  // <strings-offset>     relative to the beginning of the index
+  // <strings-size>
+  // <sha256sum>          pkg_package_manifests::sha256sum
+  // <source-sha256sum>   packages.manifest checksum
+  // <packages>           <package-count> fixed-size package records
+  // <strings>            string table
+  //
+  // Where the checksums and the package record fields are the <offset>
+  // <size> pairs, which refer to the strings in the string table. Each
+  // package record consists of the following fields:
+  //
+  // <name>               package name
+  // <version>            original version representation
+  // <version-key>        version::compare_key() data
+  // <location>           package archive location
+  // <sha256sum>          package archive checksum
+  // <manifest>           serialized package manifest
+  //
+  // Note that the version key allows to compare the package versions (as
+  // memcmp()'ed byte sequences) without parsing them.
+  //
+  // The source checksum is the checksum of the packages.manifest file the
+  // index is produced from (normally available from signature.manifest)
+  // and allows the index user to make sure that the index corresponds to
+  // the package manifest list. If the format version changes in a backward-
+  // incompatible way, then the index should be regenerated from the
+  // package manifest list.
+  //
+  class LIBBPKG_EXPORT binary_package_index
+  {
+  public:
+    static const std::uint32_t format_version = 1;
+
+    // Sub-string of the index data.
+    //
+    struct string_ref
+    {
+      const char* data;
+      std::size_t size;
+
+      std::string
+      string () const {return std::string (data, size);}
+
+      int
+      compare (const char* s, std::size_t n) const noexcept
+      {
+        int r (std::memcmp (data, s, size < n ? size : n));
+        return r != 0 ? r : size < n ? -1 : size > n ? 1 : 0;
+      }
+
+      int
+      compare (const std::string& s) const noexcept
+      {
+        return compare (s.c_str (), s.size ());
+      }
+
+      int
+      compare (const string_ref& s) const noexcept
+      {
+        return compare (s.data, s.size);
+      }
+    };
+
+    struct package
+    {
+      string_ref name;
+      string_ref version;
+      string_ref version_key;
+      string_ref location;
+      string_ref sha256sum; // Empty if absent.
+      string_ref manifest;
+    };
+
+    // Verify the index header and package records and throw
+    // invalid_argument if the data is not a valid index (bad magic, format
+    // version mismatch, out-of-bounds offsets, etc). The index data is not
+    // copied and must stay valid while the index is in use.
+    //
+    binary_package_index (const char* data, std::size_t size);
+
+    std::size_t
+    size () const noexcept {return size_;}
+
+    bool
+    empty () const noexcept {return size_ == 0;}
+
+    // Note: the index must be less than size().
+    //
+    package
+    operator[] (std::size_t) const noexcept;
+
+    string_ref
+    sha256sum () const noexcept;
+
+    string_ref
+    source_sha256sum () const noexcept;
+
+    // Parse the complete package manifest of the package with the specified
+    // index. Throw manifest_parsing on error (normally because the index is
+    // produced by a newer libbpkg version, unless ignore_unknown is true).
+    //
+    package_manifest
+    manifest (std::size_t, bool ignore_unknown = false) const;
+
+    // Restore the package manifest list.
+    //
+    pkg_package_manifests
+    manifests (bool ignore_unknown = false) const;
+
+  private:
+    const char* data_;
+    std::size_t size_;
+    const char* packages_;
+    const char* strings_;
+  };
+
+  // Produce the binary package index for the package manifest list. Throw
+  // invalid_argument if the index size exceeds the format limits (4GB).
+  //
+  LIBBPKG_EXPORT std::string
+  serialize_binary_package_index (const pkg_package_manifests&,
+                                  const std::string& source_sha256sum);
+}
+
+#endif // LIBBPKG_BINARY_INDEX_HXX
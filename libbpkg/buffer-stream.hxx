@@ -0,0 +1,300 @@
+// file      : libbpkg/buffer-stream.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef LIBBPKG_BUFFER_STREAM_HXX
+#define LIBBPKG_BUFFER_STREAM_HXX
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <utility> // forward(), pair
+
+#include <libbutl/sha256.hxx>
+#include <libbutl/optional.hxx>
+#include <libbutl/bufstreambuf.hxx>
+#include <libbutl/manifest-parser.hxx>
+
+namespace bpkg
+{
+  // Read-only stream buffer over a contiguous memory region (memory-mapped
+  // file, file contents read in a single system call, etc). The region is
+  // not copied and must stay valid while the buffer is in use.
+  //
+  // Note that the buffer is derived from butl::bufstreambuf, the get area of
+  // which the manifest parser (char_scanner, more precisely) accesses
+  // directly. As a result, the data is scanned in place rather than being
+  // first copied into an intermediate buffer (as, for example, with
+  // std::ifstream or std::istringstream).
+  //
+  class buffer_streambuf: public butl::bufstreambuf
+  {
+  public:
+    buffer_streambuf (const char* data, std::size_t size)
+        : bufstreambuf (size)
+    {
+      // Note that we never write into the get area.
+      //
+      char* b (const_cast<char*> (data));
+      setg (b, b, b + size);
+    }
+  };
+
+  class ibufferstream: public std::istream
+  {
+  public:
+    ibufferstream (const char* data, std::size_t size)
+        : std::istream (nullptr), buf_ (data, size)
+    {
+      rdbuf (&buf_);
+    }
+
+  private:
+    buffer_streambuf buf_;
+  };
+
+  // Read-only stream buffer that reads the data from another stream buffer
+  // (normally of a file stream) in chunks, calculating the SHA256 checksum
+  // of the data as it is read. This way the checksum of a manifest list
+  // file (packages.manifest, etc) can be verified against the signature
+  // manifest without reading the file for the second time.
+  //
+  // As buffer_streambuf, this buffer is derived from butl::bufstreambuf and
+  // so the chunks are scanned by the manifest parser in place.
+  //
+  class sha256_streambuf: public butl::bufstreambuf
+  {
+  public:
+    explicit
+    sha256_streambuf (std::streambuf& src): src_ (src) {}
+
+    // Read the remaining data, if any, and return the checksum of the
+    // complete data. After this call the buffer is at the end of data.
+    //
+    // Note that the manifest list parsing may complete before the end of
+    // data is reached (for example, the trailing whitespaces may not be
+    // read).
+    //
+    const std::string&
+    checksum ()
+    {
+      if (!checksum_)
+      {
+        while (fill ()) ;
+        checksum_ = sha256_.string ();
+      }
+
+      return *checksum_;
+    }
+
+  protected:
+    virtual int_type
+    underflow () override
+    {
+      return gptr () < egptr () || (!checksum_ && fill ())
+             ? traits_type::to_int_type (*gptr ())
+             : traits_type::eof ();
+    }
+
+  private:
+    // Read the next chunk into the get area and return false if there is no
+    // more data.
+    //
+    bool
+    fill ()
+    {
+      std::streamsize n (src_.sgetn (buf_, sizeof (buf_)));
+
+      if (n <= 0)
+      {
+        setg (buf_, buf_, buf_);
+        return false;
+      }
+
+      sha256_.append (buf_, static_cast<std::size_t> (n));
+      off_ += static_cast<std::uint64_t> (n);
+
+      setg (buf_, buf_, buf_ + n);
+      return true;
+    }
+
+  private:
+    std::streambuf& src_;
+    butl::sha256 sha256_;
+    butl::optional<std::string> checksum_;
+    char buf_[8192];
+  };
+
+  class isha256stream: public std::istream
+  {
+  public:
+    // Note that the stream exception mask is not inherited from the source
+    // stream.
+    //
+    explicit
+    isha256stream (std::istream& src)
+        : std::istream (nullptr), buf_ (*src.rdbuf ())
+    {
+      rdbuf (&buf_);
+    }
+
+    const std::string&
+    checksum () {return buf_.checksum ();}
+
+  private:
+    sha256_streambuf buf_;
+  };
+
+  // Write-only stream buffer that appends the data to a string. Normally
+  // used to serialize multiple manifests (manifest lists, etc) into a single
+  // growing buffer, reusing its storage between the writes (clearing a
+  // string doesn't release its storage).
+  //
+  // Note that in contrast to std::ostringstream, the data is written
+  // directly into the string rather than being copied out on completion.
+  // Specifically, the put area is set up over the string's spare capacity
+  // (with the string temporarily resized to its capacity), so that most
+  // writes don't result in virtual calls. As a result, the string contents
+  // is only complete after the buffer is synchronized (for example, with
+  // std::ostream::flush()) or destroyed.
+  //
+  class string_streambuf: public std::streambuf
+  {
+  public:
+    explicit
+    string_streambuf (std::string& s): str_ (s) {setup ();}
+
+    virtual
+    ~string_streambuf () override {sync ();}
+
+  protected:
+    virtual int_type
+    overflow (int_type c) override
+    {
+      if (traits_type::eq_int_type (c, traits_type::eof ()))
+        return traits_type::not_eof (c);
+
+      // Let the string grow its storage (geometrically) and set up the put
+      // area over the new spare capacity.
+      //
+      sync ();
+      str_ += traits_type::to_char_type (c);
+      setup ();
+
+      return c;
+    }
+
+    virtual std::streamsize
+    xsputn (const char* s, std::streamsize n) override
+    {
+      if (n <= epptr () - pptr ())
+      {
+        traits_type::copy (pptr (), s, static_cast<std::size_t> (n));
+        pbump (static_cast<int> (n));
+      }
+      else
+      {
+        sync ();
+        str_.append (s, static_cast<std::size_t> (n));
+        setup ();
+      }
+
+      return n;
+    }
+
+    // Shrink the string to the written data size and reset the put area.
+    //
+    virtual int
+    sync () override
+    {
+      if (pbase () != nullptr)
+      {
+        str_.resize (static_cast<std::size_t> (pptr () - &str_[0]));
+        setp (nullptr, nullptr);
+      }
+
+      return 0;
+    }
+
+  private:
+    void
+    setup ()
+    {
+      std::size_t n (str_.size ());
+      str_.resize (str_.capacity ());
+
+      char* b (&str_[0]);
+      setp (b + n, b + str_.size ());
+    }
+
+  private:
+    std::string& str_;
+  };
+
+  class obufferstream: public std::ostream
+  {
+  public:
+    explicit
+    obufferstream (std::string& s)
+        : std::ostream (nullptr), buf_ (s)
+    {
+      rdbuf (&buf_);
+    }
+
+  private:
+    string_streambuf buf_;
+  };
+
+  // Parse the manifest or manifest list of the specified type (for example,
+  // pkg_package_manifests) from a contiguous memory region, forwarding the
+  // remaining arguments (ignore_unknown, etc) to the type's manifest parser-
+  // based constructor. The name is used for diagnostics.
+  //
+  // Note that even though the input is not copied, the manifest parser still
+  // returns the names and values as strings. These are, however, moved
+  // rather than copied into the resulting manifest objects.
+  //
+  template <typename M, typename... A>
+  inline M
+  parse_manifest (const char* data,
+                  std::size_t size,
+                  const std::string& name,
+                  A&&... args)
+  {
+    ibufferstream is (data, size);
+    is.exceptions (std::ios_base::failbit | std::ios_base::badbit);
+
+    butl::manifest_parser p (is, name);
+    return M (p, std::forward<A> (args)...);
+  }
+
+  // Parse the manifest or manifest list of the specified type from a stream
+  // (as parse_manifest() above) and return it together with the SHA256
+  // checksum of the complete stream data calculated while parsing. For
+  // example:
+  //
+  // ifdstream ifs (f);
+  // auto r (parse_manifest_sha256<pkg_package_manifests> (ifs, f.string ()));
+  //
+  // if (r.second != sm.sha256sum)
+  //   ... // Fail: signature manifest mismatch.
+  //
+  template <typename M, typename... A>
+  inline std::pair<M, std::string>
+  parse_manifest_sha256 (std::istream& src,
+                         const std::string& name,
+                         A&&... args)
+  {
+    isha256stream is (src);
+    is.exceptions (std::ios_base::failbit | std::ios_base::badbit);
+
+    butl::manifest_parser p (is, name);
+    M m (p, std::forward<A> (args)...);
+
+    return std::pair<M, std::string> (std::move (m), is.checksum ());
+  }
+}
+
+#endif // LIBBPKG_BUFFER_STREAM_HXX
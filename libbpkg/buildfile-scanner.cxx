@@ -4,6 +4,10 @@
 #include <libbpkg/buildfile-scanner.hxx>
 
 #include <string>
+#include <cassert>
+#include <cstring> // memchr()
+
+#include <libbutl/optional.hxx>
 
 using namespace std;
 
@@ -35,4 +39,305 @@ namespace bpkg
         name (n), line (l), column (c), description (d)
   {
   }
+
+  // buildfile_buffer_scanner
+  //
+  // Characters that have a special meaning for the buildfile scanning.
+  //
+  static const struct special_chars
+  {
+    bool table[256];
+
+    special_chars (): table ()
+    {
+      for (char c: {'"', '\\', '(', '\'', '#', '{', '}', '\n'})
+        table[static_cast<unsigned char> (c)] = true;
+    }
+
+    bool
+    operator() (char c) const {return table[static_cast<unsigned char> (c)];}
+  } special;
+
+  void buildfile_buffer_scanner::
+  fail (const string& d) const
+  {
+    // Calculate the line and column of the current position.
+    //
+    uint64_t l (line_);
+    uint64_t c (column_);
+
+    for (const char* p (begin_); p != pos_; ++p)
+    {
+      if (*p == '\n')
+      {
+        ++l;
+        c = 1;
+      }
+      else if ((*p & 0xC0) != 0x80) // Not a UTF-8 continuation byte?
+        ++c;
+    }
+
+    throw buildfile_scanning (name_, l, c, d);
+  }
+
+  char buildfile_buffer_scanner::
+  scan_line (string& l, char stop)
+  {
+    auto next = [&l, this] () {l += *pos_++;};
+
+    // Append the characters up to (but not including) the specified
+    // position.
+    //
+    auto append = [&l, this] (const char* p)
+    {
+      l.append (pos_, p - pos_);
+      pos_ = p;
+    };
+
+    butl::optional<char> r;
+    bool double_quoted (false);
+
+    for (;;)
+    {
+      // Skip the run of characters without a special meaning. Note that the
+      // stop character is only special outside the double-quoted sequence.
+      //
+      const char* p (pos_);
+
+      for (; p != end_; ++p)
+      {
+        char c (*p);
+
+        if (special (c) || (c == stop && !double_quoted))
+          break;
+      }
+
+      if (p != pos_)
+      {
+        if (!double_quoted && (!r || *r != '\0'))
+        {
+          for (const char* i (pos_); i != p; ++i)
+          {
+            if (*i != ' ' && *i != '\t')
+            {
+              r = '\0';
+              break;
+            }
+          }
+        }
+
+        append (p);
+      }
+
+      if (pos_ == end_)
+        break;
+
+      char c (*pos_);
+
+      if (!double_quoted && (c == '\n' || c == stop))
+        break;
+
+      switch (c)
+      {
+      case '\"':
+        {
+          // Start or finish scanning the double-quoted sequence.
+          //
+          double_quoted = !double_quoted;
+
+          r = '\0';
+          break;
+        }
+      case '\\':
+        {
+          next ();
+
+          if (pos_ == end_)
+            fail (double_quoted
+                  ? "unterminated double-quoted sequence"
+                  : "unterminated escape sequence");
+
+          r = '\0';
+          break;
+        }
+      case '(':
+        {
+          next ();
+
+          scan_line (l, ')');
+
+          if (pos_ == end_ || *pos_ != ')')
+            fail ("unterminated evaluation context");
+
+          next ();
+
+          r = '\0';
+          continue;
+        }
+      case '\'':
+        {
+          if (!double_quoted)
+          {
+            next ();
+
+            const char* e (
+              static_cast<const char*> (memchr (pos_, '\'', end_ - pos_)));
+
+            if (e == nullptr)
+            {
+              append (end_);
+              fail ("unterminated single-quoted sequence");
+            }
+
+            append (e + 1);
+
+            r = '\0';
+            continue;
+          }
+
+          break;
+        }
+      case '#':
+        {
+          if (!double_quoted)
+          {
+            next ();
+
+            // See if this is a multi-line comment in the form:
+            //
+            /*
+              #\
+              ...
+              #\
+            */
+            auto ml = [&next, this] () -> bool
+            {
+              if (pos_ != end_ && *pos_ == '\\')
+              {
+                next ();
+
+                if (pos_ == end_ || *pos_ == '\n')
+                  return true;
+              }
+
+              return false;
+            };
+
+            if (ml ())
+            {
+              // Scan until we see the closing one.
+              //
+              for (char c ('\n');; )
+              {
+                if (c == '#' && ml ())
+                  break;
+
+                if (pos_ == end_)
+                  fail ("unterminated multi-line comment");
+
+                c = *pos_;
+                next ();
+              }
+            }
+            else
+            {
+              // Read until newline or eos.
+              //
+              const char* e (
+                static_cast<const char*> (memchr (pos_, '\n', end_ - pos_)));
+
+              append (e != nullptr ? e : end_);
+            }
+
+            continue;
+          }
+
+          break;
+        }
+      case '{':
+      case '}':
+        {
+          if (!double_quoted)
+            r = !r ? c : '\0';
+
+          break;
+        }
+      default:
+        {
+          // Can only be newline in the double-quoted sequence.
+          //
+          break;
+        }
+      }
+
+      next ();
+    }
+
+    if (double_quoted)
+      fail ("unterminated double-quoted sequence");
+
+    return r ? *r : '\0';
+  }
+
+  string buildfile_buffer_scanner::
+  scan_line (char stop)
+  {
+    string r;
+    scan_line (r, stop);
+    return r;
+  }
+
+  string buildfile_buffer_scanner::
+  scan_eval ()
+  {
+    string r;
+    scan_line (r, ')');
+
+    if (pos_ == end_ || *pos_ != ')')
+      fail ("unterminated evaluation context");
+
+    return r;
+  }
+
+  string buildfile_buffer_scanner::
+  scan_block ()
+  {
+    string r;
+    for (size_t level (0);; )
+    {
+      if (pos_ == end_)
+        fail ("unterminated buildfile block");
+
+      size_t n (r.size ());
+      char bc (scan_line (r, '\0'));
+
+      // Append the newline unless this is eos.
+      //
+      if (pos_ != end_)
+      {
+        assert (*pos_ == '\n');
+        r += *pos_++;
+      }
+
+      if (bc == '{')
+      {
+        ++level;
+      }
+      else if (bc == '}')
+      {
+        // If this is the fragment terminating line, then strip it from the
+        // fragment and bail out.
+        //
+        if (level == 0)
+        {
+          r.resize (n);
+          break;
+        }
+        else
+          --level;
+      }
+    }
+
+    return r;
+  }
 }
@@ -89,6 +89,79 @@ namespace bpkg
     const std::string& name_;
     std::string        ebuf_; // Error message buffer.
   };
+
+  // As above but scan a buildfile fragment in a contiguous memory region,
+  // which is not copied and must stay valid while the scanner is in use.
+  //
+  // In contrast to the char_scanner-based scanner, the runs of characters
+  // without a special meaning are skipped and appended to the resulting
+  // fragment in bulk and the line and column are only calculated on error.
+  // Note also that the fragment is expected to already be validated as UTF-8
+  // (for example, by the manifest parser) and the column is counted in
+  // codepoints, as by char_scanner.
+  //
+  // This is the scanner used for the depends and requires manifest value
+  // clauses (enable, reflect, prefer, etc), which the dependency lexer scans
+  // in place. The position() and skip() functions allow the caller to
+  // continue lexing right after the scanned fragment.
+  //
+  class LIBBPKG_EXPORT buildfile_buffer_scanner
+  {
+  public:
+    // Note that name is stored by shallow reference. The line and column
+    // are of the fragment's first character and are only used for
+    // diagnostics.
+    //
+    buildfile_buffer_scanner (const char* data,
+                              std::size_t size,
+                              const std::string& name,
+                              std::uint64_t line = 1,
+                              std::uint64_t column = 1)
+        : begin_ (data),
+          pos_ (data),
+          end_ (data + size),
+          name_ (name),
+          line_ (line),
+          column_ (column) {}
+
+    // See buildfile_scanner for the semantics of these functions.
+    //
+    std::string
+    scan_line (char stop = '\0');
+
+    std::string
+    scan_eval ();
+
+    std::string
+    scan_block ();
+
+    // Return the current position in the region (that is, the number of
+    // characters scanned so far) or skip the specified number of characters.
+    //
+    std::size_t
+    position () const {return pos_ - begin_;}
+
+    void
+    skip (std::size_t n = 1) {pos_ += n;}
+
+    bool
+    eos () const {return pos_ == end_;}
+
+  private:
+    char
+    scan_line (std::string& l, char stop);
+
+    [[noreturn]] void
+    fail (const std::string& description) const;
+
+  private:
+    const char*        begin_;
+    const char*        pos_;
+    const char*        end_;
+    const std::string& name_;
+    std::uint64_t      line_;
+    std::uint64_t      column_;
+  };
 }
 
 #include <libbpkg/buildfile-scanner.txx>
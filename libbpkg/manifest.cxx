@@ -6,29 +6,38 @@
 #include <string>
 #include <limits>
 #include <ostream>
-#include <sstream>
 #include <cassert>
 #include <cstdlib>     // strtoull()
-#include <cstring>     // strncmp(), strcmp(), strchr(), strcspn()
+#include <cstring>     // strncmp(), strcmp(), strchr(), strcspn(), memcpy(),
+                       // memchr()
 #include <utility>     // move()
 #include <cstdint>     // uint*_t
-#include <algorithm>   // find(), find_if(), find_first_of(), replace()
+#include <algorithm>   // find(), find_if(), find_first_of(), replace(),
+                       // lower_bound(), stable_sort(), partition_point(),
+                       // sort()
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <exception>   // exception_ptr, current_exception(), rethrow_exception()
 #include <stdexcept>   // invalid_argument
 #include <type_traits> // remove_reference
+#include <system_error>
 
 #include <libbutl/url.hxx>
 #include <libbutl/path.hxx>
 #include <libbutl/utf8.hxx>
 #include <libbutl/base64.hxx>
+#include <libbutl/sha256.hxx>
 #include <libbutl/utility.hxx>             // icasecmp(), lcase(), alnum(),
                                            // digit(), xdigit(), next_word()
 #include <libbutl/filesystem.hxx>          // dir_exist()
+#include <libbutl/path-pattern.hxx>        // path_match(), path_pattern()
 #include <libbutl/small-vector.hxx>
-#include <libbutl/char-scanner.hxx>
 #include <libbutl/manifest-parser.hxx>
 #include <libbutl/manifest-serializer.hxx>
 #include <libbutl/standard-version.hxx>
 
+#include <libbpkg/buffer-stream.hxx>
 #include <libbpkg/buildfile-scanner.hxx>
 
 using namespace std;
@@ -96,20 +105,23 @@ namespace bpkg
     return true;
   }
 
+  // Note that this function is used while serializing manifests, so let's
+  // avoid going through a string stream.
+  //
   template <typename T>
   static string
   concatenate (const T& s, const char* delim = ", ")
   {
-    ostringstream o;
+    string r;
     for (auto b (s.begin ()), i (b), e (s.end ()); i != e; ++i)
     {
       if (i != b)
-        o << delim;
+        r += delim;
 
-      o << *i;
+      r += *i;
     }
 
-    return o.str ();
+    return r;
   }
 
   // list_parser
@@ -612,6 +624,383 @@ namespace bpkg
     return v;
   }
 
+  version_key version::
+  compare_key (bool ignore_revision, bool ignore_iteration) const
+  {
+    // Note that the canonical parts may not contain the zero byte and so it
+    // can be used as a terminator. Since it is less than any other byte, a
+    // part that is a prefix of another one is also less in the key.
+    //
+    std::string k;
+    k.reserve (canonical_upstream.size () + canonical_release.size () + 11);
+
+    auto add = [&k] (uint32_t v, size_t n)
+    {
+      for (; n != 0; --n)
+        k += static_cast<char> ((v >> ((n - 1) * 8)) & 0xFF);
+    };
+
+    add (epoch, 2);
+
+    k += canonical_upstream;
+    k += '\0';
+
+    k += canonical_release;
+    k += '\0';
+
+    if (!ignore_revision)
+    {
+      // Note that the absent revision is less than any present one.
+      //
+      k += revision ? '\1' : '\0';
+      add (revision ? *revision : 0, 2);
+
+      if (!ignore_iteration)
+        add (iteration, 4);
+    }
+
+    return version_key (move (k));
+  }
+
+  // compact_version
+  //
+  // Offsets of the compact version block parts (see the class description
+  // for the block layout).
+  //
+  static const size_t compact_epoch_offset     (0);
+  static const size_t compact_flags_offset     (2);
+  static const size_t compact_revision_offset  (3);
+  static const size_t compact_iteration_offset (5);
+  static const size_t compact_lengths_offset   (9);
+  static const size_t compact_chars_offset     (25);
+
+  enum compact_part {upstream_part,
+                     release_part,
+                     canonical_upstream_part,
+                     canonical_release_part};
+
+  template <typename T>
+  static inline T
+  compact_get (const char* d, size_t o) noexcept
+  {
+    T r;
+    memcpy (&r, d + o, sizeof (T));
+    return r;
+  }
+
+  template <typename T>
+  static inline void
+  compact_set (char* d, size_t o, T v) noexcept
+  {
+    memcpy (d + o, &v, sizeof (T));
+  }
+
+  static inline size_t
+  compact_block_size (const char* d) noexcept
+  {
+    size_t r (compact_chars_offset);
+
+    for (size_t i (0); i != 4; ++i)
+      r += compact_get<uint32_t> (d, compact_lengths_offset + i * 4);
+
+    return r;
+  }
+
+  // Return the pointer to the block part characters and set the length.
+  // Note that the block must be present.
+  //
+  static inline const char*
+  compact_get_part (const char* d, compact_part p, size_t& n) noexcept
+  {
+    size_t o (compact_chars_offset);
+
+    for (size_t i (0); i != static_cast<size_t> (p); ++i)
+      o += compact_get<uint32_t> (d, compact_lengths_offset + i * 4);
+
+    n = compact_get<uint32_t> (d, compact_lengths_offset + p * 4);
+    return d + o;
+  }
+
+  compact_version::
+  compact_version (const version& v)
+  {
+    if (v.empty ())
+      return;
+
+    const std::string* ps[] = {&v.upstream,
+                               v.release ? &*v.release : nullptr,
+                               &v.canonical_upstream,
+                               &v.canonical_release};
+
+    size_t n (compact_chars_offset);
+    for (const std::string* p: ps)
+    {
+      if (p != nullptr)
+        n += p->size ();
+    }
+
+    data_ = new char[n];
+
+    compact_set<uint16_t> (data_, compact_epoch_offset, v.epoch);
+
+    compact_set<uint8_t> (data_,
+                          compact_flags_offset,
+                          (v.release  ? 0x01 : 0) |
+                          (v.revision ? 0x02 : 0));
+
+    compact_set<uint16_t> (data_, compact_revision_offset,
+                           v.revision ? *v.revision : 0);
+
+    compact_set<uint32_t> (data_, compact_iteration_offset, v.iteration);
+
+    char* c (data_ + compact_chars_offset);
+    for (size_t i (0); i != 4; ++i)
+    {
+      const std::string* p (ps[i]);
+      uint32_t l (p != nullptr ? static_cast<uint32_t> (p->size ()) : 0);
+
+      compact_set<uint32_t> (data_, compact_lengths_offset + i * 4, l);
+
+      if (l != 0)
+      {
+        memcpy (c, p->data (), l);
+        c += l;
+      }
+    }
+  }
+
+  compact_version::
+  compact_version (const compact_version& v)
+  {
+    if (v.data_ != nullptr)
+    {
+      size_t n (compact_block_size (v.data_));
+      data_ = new char[n];
+      memcpy (data_, v.data_, n);
+    }
+  }
+
+  compact_version& compact_version::
+  operator= (compact_version&& v) noexcept
+  {
+    if (this != &v)
+    {
+      delete[] data_;
+      data_ = v.data_;
+      v.data_ = nullptr;
+    }
+
+    return *this;
+  }
+
+  compact_version& compact_version::
+  operator= (const compact_version& v)
+  {
+    if (this != &v)
+      *this = compact_version (v);
+
+    return *this;
+  }
+
+  compact_version::
+  operator version () const
+  {
+    return data_ != nullptr
+           ? version (epoch (),
+                      upstream (),
+                      release (),
+                      revision (),
+                      iteration ())
+           : version ();
+  }
+
+  uint16_t compact_version::
+  epoch () const noexcept
+  {
+    return data_ != nullptr
+           ? compact_get<uint16_t> (data_, compact_epoch_offset)
+           : 0;
+  }
+
+  std::string compact_version::
+  upstream () const
+  {
+    if (data_ == nullptr)
+      return std::string ();
+
+    size_t n;
+    const char* p (compact_get_part (data_, upstream_part, n));
+    return std::string (p, n);
+  }
+
+  optional<std::string> compact_version::
+  release () const
+  {
+    // Note that the empty version has the empty release.
+    //
+    if (data_ == nullptr)
+      return std::string ();
+
+    if ((compact_get<uint8_t> (data_, compact_flags_offset) & 0x01) == 0)
+      return nullopt;
+
+    size_t n;
+    const char* p (compact_get_part (data_, release_part, n));
+    return std::string (p, n);
+  }
+
+  optional<uint16_t> compact_version::
+  revision () const noexcept
+  {
+    if (data_ == nullptr ||
+        (compact_get<uint8_t> (data_, compact_flags_offset) & 0x02) == 0)
+      return nullopt;
+
+    return compact_get<uint16_t> (data_, compact_revision_offset);
+  }
+
+  uint32_t compact_version::
+  iteration () const noexcept
+  {
+    return data_ != nullptr
+           ? compact_get<uint32_t> (data_, compact_iteration_offset)
+           : 0;
+  }
+
+  std::string compact_version::
+  canonical_upstream () const
+  {
+    if (data_ == nullptr)
+      return std::string ();
+
+    size_t n;
+    const char* p (compact_get_part (data_, canonical_upstream_part, n));
+    return std::string (p, n);
+  }
+
+  std::string compact_version::
+  canonical_release () const
+  {
+    if (data_ == nullptr)
+      return std::string ();
+
+    size_t n;
+    const char* p (compact_get_part (data_, canonical_release_part, n));
+    return std::string (p, n);
+  }
+
+  std::string compact_version::
+  string (bool ignore_revision, bool ignore_iteration) const
+  {
+    return version (*this).string (ignore_revision, ignore_iteration);
+  }
+
+  int compact_version::
+  compare (const compact_version& v, bool ir, bool ii) const noexcept
+  {
+    uint16_t e (epoch ());
+    uint16_t ve (v.epoch ());
+
+    if (e != ve)
+      return e < ve ? -1 : 1;
+
+    // Compare the canonical parts as std::string::compare() does.
+    //
+    auto cmp = [this, &v] (compact_part p) -> int
+    {
+      size_t n (0);
+      size_t vn (0);
+
+      const char* s (data_ != nullptr
+                     ? compact_get_part (data_, p, n)
+                     : nullptr);
+
+      const char* vs (v.data_ != nullptr
+                      ? compact_get_part (v.data_, p, vn)
+                      : nullptr);
+
+      if (size_t m = n < vn ? n : vn)
+      {
+        if (int r = memcmp (s, vs, m))
+          return r;
+      }
+
+      return n < vn ? -1 : n > vn ? 1 : 0;
+    };
+
+    if (int c = cmp (canonical_upstream_part))
+      return c;
+
+    if (int c = cmp (canonical_release_part))
+      return c;
+
+    if (!ir)
+    {
+      optional<uint16_t> r (revision ());
+      optional<uint16_t> vr (v.revision ());
+
+      if (r != vr)
+        return r < vr ? -1 : 1;
+
+      if (!ii)
+      {
+        uint32_t i (iteration ());
+        uint32_t vi (v.iteration ());
+
+        if (i != vi)
+          return i < vi ? -1 : 1;
+      }
+    }
+
+    return 0;
+  }
+
+  size_t compact_version::
+  capacity () const noexcept
+  {
+    return data_ != nullptr ? compact_block_size (data_) : 0;
+  }
+
+  // version_pool
+  //
+  version_handle version_pool::
+  intern (const std::string& s, version::flags fl)
+  {
+    assert (static_cast<size_t> (fl) < 4);
+
+    unordered_map<std::string, const version*>& ps (parsed_[fl]);
+
+    auto i (ps.find (s));
+    if (i == ps.end ())
+      i = ps.emplace (s, intern (version (s, fl)).get ()).first;
+
+    return version_handle (i->second);
+  }
+
+  version_handle version_pool::
+  intern (const version& v)
+  {
+    std::string s (!v.empty () ? v.string () : std::string ());
+
+    auto i (versions_.find (s));
+    if (i == versions_.end ())
+      i = versions_.emplace (move (s), v).first;
+
+    return version_handle (&i->second);
+  }
+
+  version_handle version_pool::
+  intern (version&& v)
+  {
+    std::string s (!v.empty () ? v.string () : std::string ());
+
+    auto i (versions_.find (s));
+    if (i == versions_.end ())
+      i = versions_.emplace (move (s), move (v)).first;
+
+    return version_handle (&i->second);
+  }
+
   // text_file
   //
   text_file::
@@ -1193,6 +1582,165 @@ namespace bpkg
     return r;
   }
 
+  // satisfies(), intersect(), and subsumes()
+  //
+
+  // Compare the version with the constraint endpoint version, ignoring
+  // iterations. Ignore the revision if the endpoint revision is absent and
+  // treat the absent version revision as zero otherwise (see
+  // version_constraint for details).
+  //
+  static int
+  compare_endpoint (const version& v, const version& e) noexcept
+  {
+    if (int r = v.compare (e,
+                           true /* ignore_revision */,
+                           true /* ignore_iteration */))
+      return r;
+
+    if (!e.revision)
+      return 0;
+
+    uint16_t vr (v.revision ? *v.revision : 0);
+    return vr < *e.revision ? -1 : vr > *e.revision ? 1 : 0;
+  }
+
+  bool
+  satisfies (const version& v, const version_constraint& c) noexcept
+  {
+    assert (c.complete ());
+
+    bool s (true);
+
+    if (c.min_version)
+    {
+      int i (compare_endpoint (v, *c.min_version));
+      s = c.min_open ? i > 0 : i >= 0;
+    }
+
+    if (s && c.max_version)
+    {
+      int i (compare_endpoint (v, *c.max_version));
+      s = c.max_open ? i < 0 : i <= 0;
+    }
+
+    return s;
+  }
+
+  // Represent a range endpoint as a position in the version order (with
+  // iterations ignored), which a version satisfying the min (max) endpoint
+  // is greater than or equal to (less than). The position is the pair of
+  // the endpoint version with revision ignored and the revision rank. A
+  // version with the revision N ranks N+1, with the absent revision ranking
+  // as the zero revision (see compare_endpoint() above for details). For
+  // example:
+  //
+  // [X    ->  X, 1
+  // (X    ->  X, max+2
+  // X]    ->  X, max+2
+  // X)    ->  X, 1
+  // X+N]  ->  X, N+2
+  // X+N)  ->  X, N+1
+  //
+  // Note that this way endpoints that are satisfied by the same versions but
+  // are specified differently (for example, (X+1 and [X+2 or [X and [X+0)
+  // have the same position and so compare equal.
+  //
+  static inline uint32_t
+  endpoint_revision (const version& v, bool open, bool min)
+  {
+    // Note that for an open min endpoint and a closed max endpoint the
+    // position is after the respective revision(s).
+    //
+    uint32_t a (open == min ? 1 : 0);
+
+    return v.revision
+           ? static_cast<uint32_t> (*v.revision) + 1 + a
+           : a != 0 ? static_cast<uint32_t> (UINT16_MAX) + 2 : 1;
+  }
+
+  static int
+  compare_endpoints (const version& x, bool xo, bool xm,
+                     const version& y, bool yo, bool ym) noexcept
+  {
+    if (int r = x.compare (y, true /* ignore_revision */, true))
+      return r;
+
+    uint32_t xr (endpoint_revision (x, xo, xm));
+    uint32_t yr (endpoint_revision (y, yo, ym));
+
+    return xr < yr ? -1 : xr > yr ? 1 : 0;
+  }
+
+  // Compare the min (max) endpoints of two constraints, treating an absent
+  // endpoint as the minus (plus) infinity.
+  //
+  static int
+  compare_min (const version_constraint& x,
+               const version_constraint& y) noexcept
+  {
+    if (!x.min_version || !y.min_version)
+      return x.min_version ? 1 : y.min_version ? -1 : 0;
+
+    return compare_endpoints (*x.min_version, x.min_open, true,
+                              *y.min_version, y.min_open, true);
+  }
+
+  static int
+  compare_max (const version_constraint& x,
+               const version_constraint& y) noexcept
+  {
+    if (!x.max_version || !y.max_version)
+      return x.max_version ? -1 : y.max_version ? 1 : 0;
+
+    return compare_endpoints (*x.max_version, x.max_open, false,
+                              *y.max_version, y.max_open, false);
+  }
+
+  // Return true if no version can satisfy both the min endpoint of the
+  // first constraint and the max endpoint of the second constraint.
+  //
+  static bool
+  empty_range (const version_constraint& mn,
+               const version_constraint& mx) noexcept
+  {
+    return mn.min_version && mx.max_version &&
+           compare_endpoints (*mn.min_version, mn.min_open, true,
+                              *mx.max_version, mx.max_open, false) >= 0;
+  }
+
+  optional<version_constraint>
+  intersect (const version_constraint& x, const version_constraint& y)
+  {
+    assert (x.complete () && y.complete ());
+
+    const version_constraint& mn (compare_min (x, y) >= 0 ? x : y);
+    const version_constraint& mx (compare_max (x, y) <= 0 ? x : y);
+
+    if (empty_range (mn, mx))
+      return nullopt;
+
+    // Note that we don't use the validating constructor since the
+    // intersection can be a valid but unusually specified range (for
+    // example, (X+0 X]), which it doesn't recognize.
+    //
+    version_constraint r;
+    r.min_version = mn.min_version;
+    r.min_open    = mn.min_open;
+    r.max_version = mx.max_version;
+    r.max_open    = mx.max_open;
+    return r;
+  }
+
+  bool
+  subsumes (const version_constraint& x, const version_constraint& y) noexcept
+  {
+    assert (x.complete () && y.complete ());
+
+    return empty_range (y, y) ||
+           (compare_min (x, y) <= 0 && compare_max (x, y) >= 0);
+  }
+
   // dependency
   //
   dependency::
@@ -1340,7 +1888,11 @@ namespace bpkg
 
   // dependency_alternatives
   //
-  class dependency_alternatives_lexer: public char_scanner<utf8_validator>
+  // Note that the lexer scans the value in place, as a contiguous character
+  // range, rather than through char_scanner over a stream. The buildfile
+  // fragments are scanned with buildfile_buffer_scanner over the same range.
+  //
+  class dependency_alternatives_lexer
   {
   public:
     enum class token_type
@@ -1385,43 +1937,56 @@ namespace bpkg
       string (bool diag = true) const;
     };
 
+    // Extended character, similar to char_scanner::xchar. The eos value is
+    // represented as -1.
+    //
+    struct xchar
+    {
+      int value;
+
+      uint64_t line;
+      uint64_t column;
+
+      operator char () const {return static_cast<char> (value);}
+    };
+
+    static bool
+    eos (const xchar& c) {return c.value == -1;}
+
     // If true, then comments are allowed and are treated as whitespace
     // characters.
     //
     bool comments = false;
 
   public:
-    // Note that name is stored by shallow reference.
+    // Validate the character range as UTF-8, only allowing the graphic
+    // codepoints, newlines, carriage returns, and tabs, throwing
+    // manifest_parsing on error. Also normalize the CRLF sequences to LF,
+    // copying the range in this case.
+    //
+    // Note that the range is otherwise not copied and must stay valid while
+    // the lexer is in use. Also note that name is stored by shallow
+    // reference.
     //
-    dependency_alternatives_lexer (istream& is,
+    dependency_alternatives_lexer (const char* data,
+                                   size_t size,
                                    const string& name,
                                    uint64_t line,
-                                   uint64_t column)
-        : char_scanner (is,
-                        utf8_validator (codepoint_types::graphic, U"\n\r\t"),
-                        true /* crlf */,
-                        line,
-                        column),
-          name_ (name),
-          buildfile_scan_ (*this, name_) {}
-
-    // The following functions throw manifest_parsing on invalid UTF-8
-    // sequence.
-    //
+                                   uint64_t column);
 
     // Peek the next non-whitespace character.
     //
     xchar
     peek_char ();
 
-    // Extract next token (other than of the buildfile type) from the stream.
+    // Extract next token (other than of the buildfile type) from the range.
     //
     // Note that it is ok to call next() again after getting eos.
     //
     token
     next ();
 
-    // The next_*() functions extract the buildfile token from the stream.
+    // The next_*() functions extract the buildfile token from the range.
     // Throw manifest_parsing on error (invalid buildfile fragment, etc).
     //
     // Note that they are just thin wrappers around the scan_*() functions
@@ -1437,49 +2002,191 @@ namespace bpkg
     next_block ();
 
   private:
-    using base = char_scanner<utf8_validator>;
+    xchar
+    peek () const
+    {
+      return xchar {pos_ != end_ ? static_cast<unsigned char> (*pos_) : -1,
+                    line_,
+                    column_};
+    }
 
     xchar
     get ()
     {
-      xchar c (base::get (ebuf_));
+      xchar c (peek ());
 
-      if (invalid (c))
-        throw parsing (name_, c.line, c.column, ebuf_);
+      if (!eos (c))
+        skip ();
 
       return c;
     }
 
     void
-    get (const xchar& peeked)
+    get (const xchar&)
     {
-      base::get (peeked);
+      skip ();
     }
 
-    xchar
-    peek ()
+    // Skip the current character updating the line and column. Note that
+    // the column is counted in codepoints, as by char_scanner.
+    //
+    void
+    skip ()
     {
-      xchar c (base::peek (ebuf_));
+      char c (*pos_++);
 
-      if (invalid (c))
-        throw parsing (name_, c.line, c.column, ebuf_);
-
-      return c;
+      if (c == '\n')
+      {
+        ++line_;
+        column_ = 1;
+      }
+      else if ((c & 0xC0) != 0x80) // Not a UTF-8 continuation byte?
+        ++column_;
     }
 
+    // Skip the specified number of characters.
+    //
+    void
+    skip (size_t n);
+
     void
     skip_spaces ();
 
+    // Scan the buildfile fragment at the current position using the
+    // specified buildfile_buffer_scanner function, skip it, and return the
+    // scanned fragment.
+    //
+    template <typename F>
+    string
+    scan_buildfile (const F&);
+
   private:
     const string& name_;
 
-    // Buffer for a get()/peek() potential error.
-    //
-    string ebuf_;
+    const char* pos_;
+    const char* end_;
+
+    uint64_t line_;
+    uint64_t column_;
 
-    buildfile_scanner<utf8_validator, 1> buildfile_scan_;
+    // Normalized copy of the range, if it contains CRLF sequences.
+    //
+    string buf_;
   };
 
+  dependency_alternatives_lexer::
+  dependency_alternatives_lexer (const char* d,
+                                 size_t n,
+                                 const string& name,
+                                 uint64_t l,
+                                 uint64_t c)
+      : name_ (name), line_ (l), column_ (c)
+  {
+    // Note that the value normally comes from the manifest parser, which
+    // already normalizes CRLF, so copying is unlikely.
+    //
+    if (n != 0 && memchr (d, '\r', n) != nullptr)
+    {
+      buf_.reserve (n);
+
+      for (const char* p (d), *e (d + n); p != e; ++p)
+      {
+        if (*p != '\r' || p + 1 == e || p[1] != '\n')
+          buf_ += *p;
+      }
+
+      d = buf_.data ();
+      n = buf_.size ();
+    }
+
+    pos_ = d;
+    end_ = d + n;
+
+    // Validate the range. Only pass the non-ASCII and control characters to
+    // the validator, skipping the printable ASCII characters quickly.
+    //
+    utf8_validator val (codepoint_types::graphic, U"\n\r\t");
+    string what;
+    bool complete (true);
+
+    for (const char* p (pos_); p != end_; ++p)
+    {
+      char ch (*p);
+
+      if (complete)
+      {
+        unsigned char u (static_cast<unsigned char> (ch));
+
+        if (u >= 0x20 && u < 0x7F)
+        {
+          ++c;
+          continue;
+        }
+
+        if (ch == '\n')
+        {
+          ++l;
+          c = 1;
+          continue;
+        }
+      }
+
+      pair<bool, bool> r (val.validate (ch, what));
+
+      if (!r.first)
+        throw parsing (name_, l, c, what);
+
+      complete = r.second;
+
+      if (complete)
+        ++c;
+    }
+
+    if (!complete)
+      throw parsing (name_, l, c, "incomplete UTF-8 sequence");
+  }
+
+  void dependency_alternatives_lexer::
+  skip (size_t n)
+  {
+    const char* e (pos_ + n);
+
+    // Skip the lines quickly and only count the codepoints on the last one.
+    //
+    for (const char* p;
+         (p = static_cast<const char*> (memchr (pos_, '\n', e - pos_))) !=
+           nullptr;
+         pos_ = p + 1)
+    {
+      ++line_;
+      column_ = 1;
+    }
+
+    for (; pos_ != e; ++pos_)
+    {
+      if ((*pos_ & 0xC0) != 0x80)
+        ++column_;
+    }
+  }
+
+  template <typename F>
+  string dependency_alternatives_lexer::
+  scan_buildfile (const F& f)
+  {
+    buildfile_buffer_scanner s (pos_, end_ - pos_, name_, line_, column_);
+
+    try
+    {
+      string r (f (s));
+      skip (s.position ());
+      return r;
+    }
+    catch (const buildfile_scanning& e)
+    {
+      throw parsing (e.name, e.line, e.column, e.description);
+    }
+  }
+
   dependency_alternatives_lexer::token dependency_alternatives_lexer::
   next ()
   {
@@ -1487,8 +2194,8 @@ namespace bpkg
 
     skip_spaces ();
 
-    uint64_t ln (line);
-    uint64_t cl (column);
+    uint64_t ln (line_);
+    uint64_t cl (column_);
 
     xchar c (get ());
 
@@ -1557,18 +2264,19 @@ namespace bpkg
     // Starts with a non-whitespace character which has not been recognized as
     // a part of some other token.
     //
-    string r (1, c);
-
-    // Add subsequent characters until eos or separator is encountered.
+    // Add subsequent characters until eos or separator is encountered. Note
+    // that the separators don't include newline, so only the column changes.
     //
+    const char* b (pos_ - 1);
     const char* s (" \n\t?(){}[]=<>~^|");
-    for (c = peek (); !eos (c) && strchr (s, c) == nullptr; c = peek ())
+
+    for (; pos_ != end_ && strchr (s, *pos_) == nullptr; ++pos_)
     {
-      r += c;
-      get (c);
+      if ((*pos_ & 0xC0) != 0x80)
+        ++column_;
     }
 
-    return make_token (type::word, move (r));
+    return make_token (type::word, string (b, pos_ - b));
   }
 
   dependency_alternatives_lexer::token dependency_alternatives_lexer::
@@ -1576,22 +2284,19 @@ namespace bpkg
   {
     skip_spaces ();
 
-    uint64_t ln (line);
-    uint64_t cl (column);
+    uint64_t ln (line_);
+    uint64_t cl (column_);
 
-    try
-    {
-      // Strip the trailing whitespaces.
-      //
-      return token {token_type::buildfile,
-                    trim (buildfile_scan_.scan_eval ()),
-                    ln,
-                    cl};
-    }
-    catch (const buildfile_scanning& e)
-    {
-      throw parsing (e.name, e.line, e.column, e.description);
-    }
+    // Strip the trailing whitespaces.
+    //
+    return token {token_type::buildfile,
+                  trim (scan_buildfile (
+                          [] (buildfile_buffer_scanner& s)
+                          {
+                            return s.scan_eval ();
+                          })),
+                  ln,
+                  cl};
   }
 
   dependency_alternatives_lexer::token dependency_alternatives_lexer::
@@ -1599,44 +2304,38 @@ namespace bpkg
   {
     skip_spaces ();
 
-    uint64_t ln (line);
-    uint64_t cl (column);
+    uint64_t ln (line_);
+    uint64_t cl (column_);
 
-    try
-    {
-      // Strip the trailing whitespaces.
-      //
-      return token {token_type::buildfile,
-                    trim (buildfile_scan_.scan_line (stop)),
-                    ln,
-                    cl};
-    }
-    catch (const buildfile_scanning& e)
-    {
-      throw parsing (e.name, e.line, e.column, e.description);
-    }
+    // Strip the trailing whitespaces.
+    //
+    return token {token_type::buildfile,
+                  trim (scan_buildfile (
+                          [stop] (buildfile_buffer_scanner& s)
+                          {
+                            return s.scan_line (stop);
+                          })),
+                  ln,
+                  cl};
   }
 
   dependency_alternatives_lexer::token dependency_alternatives_lexer::
   next_block ()
   {
-    uint64_t ln (line);
-    uint64_t cl (column);
+    uint64_t ln (line_);
+    uint64_t cl (column_);
 
-    try
-    {
-      // Don't trim the token value not to strip the potential block indenting
-      // on the first line.
-      //
-      return token {token_type::buildfile,
-                    buildfile_scan_.scan_block (),
-                    ln,
-                    cl};
-    }
-    catch (const buildfile_scanning& e)
-    {
-      throw parsing (e.name, e.line, e.column, e.description);
-    }
+    // Don't trim the token value not to strip the potential block indenting
+    // on the first line.
+    //
+    return token {token_type::buildfile,
+                  scan_buildfile (
+                    [] (buildfile_buffer_scanner& s)
+                    {
+                      return s.scan_block ();
+                    }),
+                  ln,
+                  cl};
   }
 
   dependency_alternatives_lexer::xchar dependency_alternatives_lexer::
@@ -1773,11 +2472,14 @@ namespace bpkg
     dependency_alternatives_parser (bool requirements = false)
         : requirements_ (requirements) {}
 
-    // Throw manifest_parsing if representation is invalid.
+    // Throw manifest_parsing if representation is invalid. Note that the
+    // character range is scanned in place (see
+    // dependency_alternatives_lexer for details).
     //
     void
     parse (const package_name& dependent,
-           istream&,
+           const char* data,
+           size_t size,
            const string& name,
            uint64_t line,
            uint64_t column,
@@ -1844,13 +2546,14 @@ namespace bpkg
 
   void dependency_alternatives_parser::
   parse (const package_name& dependent,
-         istream& is,
+         const char* data,
+         size_t size,
          const string& name,
          uint64_t line,
          uint64_t column,
          dependency_alternatives& result)
   {
-    lexer lexer (is, name, line, column);
+    lexer lexer (data, size, name, line, column);
 
     dependent_ = &dependent;
     name_ = &name;
@@ -2482,9 +3185,15 @@ namespace bpkg
       b = p == string::npos ? e : b + p;
     }
 
+    // Note that the value is scanned in place, without copying it into a
+    // temporary string or stream.
+    //
     dependency_alternatives_parser p;
-    istringstream is (b == v.begin () ? v : string (b, e));
-    p.parse (dependent, is, name, line, column, *this);
+    p.parse (dependent,
+             v.data () + (b - v.begin ()), e - b,
+             name,
+             line, column,
+             *this);
   }
 
   string dependency_alternatives::
@@ -2594,15 +3303,20 @@ namespace bpkg
 
   // requirement_alternatives
   //
-  requirement_alternatives::
-  requirement_alternatives (const std::string& s,
-                            const package_name& dependent,
-                            const std::string& name,
-                            uint64_t line,
-                            uint64_t column)
+  // Parse the requirement alternatives representation into the temporary
+  // dependency alternatives in the requirements mode, saving the comment and
+  // the build-time flag. Throw manifest_parsing if the representation is
+  // invalid.
+  //
+  static dependency_alternatives
+  parse_requirement_alternatives (const string& s,
+                                  const package_name& dependent,
+                                  const string& name,
+                                  uint64_t line,
+                                  uint64_t column,
+                                  string& comment,
+                                  bool& buildtime)
   {
-    using std::string;
-
     auto vc (parser::split_comment (s));
 
     comment = move (vc.second);
@@ -2619,34 +3333,28 @@ namespace bpkg
       b = p == string::npos ? e : b + p;
     }
 
-    // We will use the dependency alternatives parser to parse the
-    // representation into a temporary dependency alternatives in the
-    // requirements mode. Then we will move the dependency alternatives into
-    // the requirement alternatives using the string representation of the
-    // dependencies.
-    //
     dependency_alternatives_parser p (true /* requirements */);
-    istringstream is (b == v.begin () ? v : string (b, e));
-
-    dependency_alternatives das;
-    p.parse (dependent, is, name, line, column, das);
-
-    for (dependency_alternative& da: das)
-    {
-      requirement_alternative ra (move (da.enable), move (da.reflect));
-
-      // Also handle the simple requirement.
-      //
-      for (dependency& d: da)
-        ra.push_back (!d.name.empty () ? d.string () : string ());
 
-      push_back (move (ra));
-    }
+    dependency_alternatives r;
+    p.parse (dependent,
+             v.data () + (b - v.begin ()), e - b,
+             name,
+             line, column,
+             r);
 
     // Make sure that the simple requirement is accompanied with a non-empty
     // comment.
     //
-    if (simple () && comment.empty ())
+    // Note that the parser makes sure that the simple requirement is the
+    // only alternative in the representation (see
+    // requirement_alternatives::simple() for details).
+    //
+    const dependency_alternative& da (r.back ());
+
+    if (r.size () == 1  &&
+        da.size () == 1 &&
+        (da[0].name.empty () || (da.enable && da.enable->empty ())) &&
+        comment.empty ())
     {
       // Let's describe the following error cases differently:
       //
@@ -2656,10 +3364,49 @@ namespace bpkg
       throw parsing (name,
                      line,
                      column,
-                     (back ().enable
+                     (da.enable
                       ? "no comment specified for simple requirement"
                       : "requirement or comment expected"));
     }
+
+    return r;
+  }
+
+  requirement_alternatives::
+  requirement_alternatives (const std::string& s,
+                            const package_name& dependent,
+                            const std::string& name,
+                            uint64_t line,
+                            uint64_t column)
+  {
+    using std::string;
+
+    // We will use the dependency alternatives parser to parse the
+    // representation into a temporary dependency alternatives in the
+    // requirements mode. Then we will move the dependency alternatives into
+    // the requirement alternatives using the string representation of the
+    // dependencies.
+    //
+    dependency_alternatives das (
+      parse_requirement_alternatives (s,
+                                      dependent,
+                                      name,
+                                      line,
+                                      column,
+                                      comment,
+                                      buildtime));
+
+    for (dependency_alternative& da: das)
+    {
+      requirement_alternative ra (move (da.enable), move (da.reflect));
+
+      // Also handle the simple requirement.
+      //
+      for (dependency& d: da)
+        ra.push_back (!d.name.empty () ? d.string () : string ());
+
+      push_back (move (ra));
+    }
   }
 
   std::string requirement_alternatives::
@@ -3054,6 +3801,173 @@ namespace bpkg
     match_classes (cs, im, expr, r);
   }
 
+  // build_class_set
+  //
+  build_class_set& build_class_set::
+  operator|= (const build_class_set& s)
+  {
+    assert (words_.size () == s.words_.size ());
+
+    for (size_t i (0); i != words_.size (); ++i)
+      words_[i] |= s.words_[i];
+
+    return *this;
+  }
+
+  // build_class_universe
+  //
+  build_class_universe::
+  build_class_universe (const strings& cs,
+                        const build_class_inheritance_map& im)
+  {
+    // Assign the class ids.
+    //
+    auto add = [this] (const string& c)
+    {
+      if (!c.empty ()) // No base?
+        ids_.emplace (c, ids_.size ());
+    };
+
+    for (const string& c: cs)
+      add (c);
+
+    for (const auto& p: im)
+    {
+      add (p.first);
+      add (p.second);
+    }
+
+    // Compute the closures, walking the base class chains. Note that we
+    // bail out if the class is already in the closure to tolerate the
+    // inheritance cycles.
+    //
+    size_t n (ids_.size ());
+    closures_.resize (n, build_class_set (n));
+
+    for (const auto& p: ids_)
+    {
+      build_class_set& s (closures_[p.second]);
+      s.set (p.second);
+
+      for (auto i (im.find (p.first)); i != im.end (); i = im.find (i->second))
+      {
+        auto j (ids_.find (i->second));
+
+        if (j == ids_.end () || s.test (j->second))
+          break;
+
+        s.set (j->second);
+      }
+    }
+  }
+
+  optional<size_t> build_class_universe::
+  find (const string& c) const
+  {
+    auto i (ids_.find (c));
+    return i != ids_.end () ? i->second : optional<size_t> ();
+  }
+
+  build_class_set build_class_universe::
+  classes (const strings& cs) const
+  {
+    build_class_set r (size ());
+
+    for (const string& c: cs)
+    {
+      auto i (ids_.find (c));
+
+      if (i == ids_.end ())
+        throw invalid_argument ("class '" + c + "' is not in universe");
+
+      r |= closures_[i->second];
+    }
+
+    return r;
+  }
+
+  // compiled_build_class_expr
+  //
+  static void
+  compile_classes (const vector<build_class_term>& expr,
+                   const build_class_universe& u,
+                   vector<compiled_build_class_expr::term>& r)
+  {
+    for (const build_class_term& t: expr)
+    {
+      if (t.simple)
+      {
+        optional<size_t> id (u.find (t.name));
+
+        r.push_back ({t.operation,
+                      t.inverted,
+                      true /* simple */,
+                      id ? *id : string::npos});
+      }
+      else
+      {
+        size_t i (r.size ());
+        r.push_back ({t.operation, t.inverted, false /* simple */, 0});
+
+        compile_classes (t.expr, u, r);
+
+        r[i].value = r.size () - i - 1;
+      }
+    }
+  }
+
+  // Match the build configuration class set against the expression terms
+  // range, updating the result (see match_classes() for details).
+  //
+  static void
+  match_classes (const build_class_set& cs,
+                 const compiled_build_class_expr::term* b,
+                 const compiled_build_class_expr::term* e,
+                 bool& r)
+  {
+    for (const compiled_build_class_expr::term* t (b); t != e; )
+    {
+      const compiled_build_class_expr::term* n (
+        t + 1 + (t->simple ? 0 : t->value));
+
+      if ((t->operation == '+') != r)
+      {
+        bool m (false);
+
+        if (t->simple)
+          m = t->value != string::npos && cs.test (t->value);
+        else
+          match_classes (cs, t + 1, n, m);
+
+        if (t->inverted)
+          m = !m;
+
+        switch (t->operation)
+        {
+        case '+': if (m) r = true;  break;
+        case '-': if (m) r = false; break;
+        case '&': r &= m;           break;
+        default:  assert (false);
+        }
+      }
+
+      t = n;
+    }
+  }
+
+  compiled_build_class_expr::
+  compiled_build_class_expr (const build_class_expr& e,
+                             const build_class_universe& u)
+  {
+    compile_classes (e.expr, u, terms);
+  }
+
+  void compiled_build_class_expr::
+  match (const build_class_set& cs, bool& r) const
+  {
+    match_classes (cs, terms.data (), terms.data () + terms.size (), r);
+  }
+
   // build_auxiliary
   //
   optional<pair<string, string>> build_auxiliary::
@@ -3183,8 +4097,11 @@ namespace bpkg
     try
     {
       dependency_alternatives_parser p;
-      istringstream is (b == v.begin () ? v : string (b, e));
-      p.parse (dn, is, "" /* name */, 1, 1, das);
+      p.parse (dn,
+               v.data () + (b - v.begin ()), e - b,
+               "" /* name */,
+               1, 1,
+               das);
     }
     catch (const manifest_parsing& e)
     {
@@ -3399,19 +4316,500 @@ namespace bpkg
 
   const version stub_version (0, "0", nullopt, nullopt, 0);
 
-  // Parse until next() returns end-of-manifest value.
+  // Parse the package name, version, location, and sha256sum manifest
+  // values. Throw manifest_parsing on error.
   //
-  static void
-  parse_package_manifest (
-    const string& name,
-    const function<name_value ()>& next,
-    const function<package_manifest::translate_function>& translate,
-    bool iu,
-    bool cv,
-    package_manifest_flags fl,
-    package_manifest& m)
+  static package_name
+  parse_package_name (name_value&& nv, const string& name)
   {
-    name_value nv;
+    try
+    {
+      return package_name (move (nv.value));
+    }
+    catch (const invalid_argument& e)
+    {
+      throw parsing (name, nv.value_line, nv.value_column,
+                     string ("invalid package name: ") + e.what ());
+    }
+  }
+
+  static version
+  parse_package_version (const name_value& nv, const string& name)
+  {
+    auto bad_value ([&name, &nv](const string& d) {
+        throw parsing (name, nv.value_line, nv.value_column, d);});
+
+    version r;
+
+    try
+    {
+      r = version (nv.value);
+    }
+    catch (const invalid_argument& e)
+    {
+      bad_value (string ("invalid package version: ") + e.what ());
+    }
+
+    // Versions like 1.2.3- are forbidden in manifest as intended to be used
+    // for version constrains rather than actual releases.
+    //
+    if (r.release && r.release->empty ())
+      bad_value ("invalid package version release");
+
+    return r;
+  }
+
+  static path
+  parse_package_location (name_value&& nv, const string& name)
+  {
+    auto bad_value ([&name, &nv](const string& d) {
+        throw parsing (name, nv.value_line, nv.value_column, d);});
+
+    try
+    {
+      path r (move (nv.value));
+
+      if (r.empty ())
+        bad_value ("empty package location");
+
+      if (r.absolute ())
+        bad_value ("absolute package location");
+
+      return r;
+    }
+    catch (const invalid_path&)
+    {
+      bad_value ("invalid package location");
+    }
+
+    assert (false); // Can't be here.
+    return path ();
+  }
+
+  static string
+  parse_package_sha256sum (name_value&& nv, const string& name)
+  {
+    if (!valid_sha256 (nv.value))
+      throw parsing (name, nv.value_line, nv.value_column,
+                     "invalid package sha256sum");
+
+    return move (nv.value);
+  }
+
+  // manifest_parsing_stats_guard
+  //
+  // Manifest parsing statistics of the current thread or NULL if disabled.
+  //
+  static thread_local manifest_parsing_stats* parsing_stats (nullptr);
+
+  manifest_parsing_stats_guard::
+  manifest_parsing_stats_guard (manifest_parsing_stats& s)
+      : prev_ (parsing_stats)
+  {
+    parsing_stats = &s;
+  }
+
+  manifest_parsing_stats_guard::
+  ~manifest_parsing_stats_guard ()
+  {
+    parsing_stats = prev_;
+  }
+
+  // Add the statistics collected by a worker thread to the caller's
+  // statistics.
+  //
+  static void
+  merge (manifest_parsing_stats& to, const manifest_parsing_stats& from)
+  {
+    using entry = manifest_parsing_stats::entry;
+
+    auto add = [] (entry& t, const entry& f)
+    {
+      t.count += f.count;
+      t.bytes += f.bytes;
+      t.time += f.time;
+    };
+
+    auto add_map = [&add] (map<string, entry>& t, const map<string, entry>& f)
+    {
+      for (const auto& v: f)
+        add (t[v.first], v.second);
+    };
+
+    add_map (to.package_values, from.package_values);
+    add_map (to.repository_values, from.repository_values);
+
+    add (to.package_manifests, from.package_manifests);
+    add (to.repository_manifests, from.repository_manifests);
+    add (to.overrides, from.overrides);
+    add (to.file_loads, from.file_loads);
+  }
+
+  namespace
+  {
+    // Add the time elapsed between the construction and destruction as well
+    // as the count and size to the statistics entry. Do nothing if the entry
+    // is NULL (normally because the statistics is disabled).
+    //
+    class stats_timer
+    {
+    public:
+      explicit
+      stats_timer (manifest_parsing_stats::entry* e,
+                   size_t bytes = 0,
+                   size_t count = 1)
+          : entry_ (e)
+      {
+        if (e != nullptr)
+        {
+          e->count += count;
+          e->bytes += bytes;
+          start_ = chrono::steady_clock::now ();
+        }
+      }
+
+      ~stats_timer ()
+      {
+        if (entry_ != nullptr)
+          entry_->time += chrono::duration_cast<chrono::nanoseconds> (
+            chrono::steady_clock::now () - start_).count ();
+      }
+
+      stats_timer (const stats_timer&) = delete;
+      stats_timer& operator= (const stats_timer&) = delete;
+
+    private:
+      manifest_parsing_stats::entry* entry_;
+      chrono::steady_clock::time_point start_;
+    };
+  }
+
+  // Package manifest value kinds.
+  //
+  // Note that some kinds correspond to multiple value names (tests,
+  // examples, and benchmarks; *-build and *-build2; etc) and the kinds with
+  // the config_ prefix correspond to the build package configuration-specific
+  // values (*-build-config, *-builds, etc).
+  //
+  enum class package_value
+  {
+    unknown,
+    name,
+    version,
+    upstream_version,
+    type,
+    language,
+    project,
+    summary,
+    topics,
+    keywords,
+    tags,
+    description,
+    description_file,
+    description_type,
+    package_description,
+    package_description_file,
+    package_description_type,
+    changes,
+    changes_file,
+    changes_type,
+    url,
+    email,
+    doc_url,
+    src_url,
+    package_url,
+    package_email,
+    build_email,
+    build_warning_email,
+    build_error_email,
+    priority,
+    license,
+    depends,
+    requires,
+    builds,
+    build_include,
+    build_exclude,
+    build_auxiliary,
+    build_bot,
+    config_build_config,
+    config_builds,
+    config_build_include,
+    config_build_exclude,
+    config_build_bot,
+    config_build_email,
+    config_build_warning_email,
+    config_build_error_email,
+    tests,
+    bootstrap_build,
+    root_build,
+    buildfile,
+    build_file,
+    distribution_name,
+    distribution_to_downstream,
+    distribution_version,
+    location,
+    sha256sum,
+    fragment
+  };
+
+  struct package_value_name
+  {
+    const char* name;
+    package_value value;
+  };
+
+  // Package manifest value names sorted lexicographically.
+  //
+  static const package_value_name package_value_names[] = {
+    {"benchmarks",                package_value::tests},
+    {"bootstrap-build",           package_value::bootstrap_build},
+    {"bootstrap-build2",          package_value::bootstrap_build},
+    {"build-bot",                 package_value::build_bot},
+    {"build-email",               package_value::build_email},
+    {"build-error-email",         package_value::build_error_email},
+    {"build-exclude",             package_value::build_exclude},
+    {"build-file",                package_value::build_file},
+    {"build-include",             package_value::build_include},
+    {"build-warning-email",       package_value::build_warning_email},
+    {"builds",                    package_value::builds},
+    {"changes",                   package_value::changes},
+    {"changes-file",              package_value::changes_file},
+    {"changes-type",              package_value::changes_type},
+    {"depends",                   package_value::depends},
+    {"description",               package_value::description},
+    {"description-file",          package_value::description_file},
+    {"description-type",          package_value::description_type},
+    {"doc-url",                   package_value::doc_url},
+    {"email",                     package_value::email},
+    {"examples",                  package_value::tests},
+    {"fragment",                  package_value::fragment},
+    {"keywords",                  package_value::keywords},
+    {"language",                  package_value::language},
+    {"license",                   package_value::license},
+    {"location",                  package_value::location},
+    {"name",                      package_value::name},
+    {"package-description",       package_value::package_description},
+    {"package-description-file",  package_value::package_description_file},
+    {"package-description-type",  package_value::package_description_type},
+    {"package-email",             package_value::package_email},
+    {"package-url",               package_value::package_url},
+    {"priority",                  package_value::priority},
+    {"project",                   package_value::project},
+    {"requires",                  package_value::requires},
+    {"root-build",                package_value::root_build},
+    {"root-build2",               package_value::root_build},
+    {"sha256sum",                 package_value::sha256sum},
+    {"src-url",                   package_value::src_url},
+    {"summary",                   package_value::summary},
+    {"tags",                      package_value::tags},
+    {"tests",                     package_value::tests},
+    {"topics",                    package_value::topics},
+    {"type",                      package_value::type},
+    {"upstream-version",          package_value::upstream_version},
+    {"url",                       package_value::url},
+    {"version",                   package_value::version}
+  };
+
+  struct package_value_suffix
+  {
+    const char* suffix;
+    size_t size;
+    package_value value;
+  };
+
+  // Package manifest value name suffixes in the order they must be checked.
+  //
+  // Note that the -to-downstream-version suffix must precede the -version
+  // suffix.
+  //
+  static const package_value_suffix package_value_suffixes[] = {
+    {"-build-config",          13, package_value::config_build_config},
+    {"-builds",                 7, package_value::config_builds},
+    {"-build-include",         14, package_value::config_build_include},
+    {"-build-exclude",         14, package_value::config_build_exclude},
+    {"-build-bot",             10, package_value::config_build_bot},
+    {"-build-email",           12, package_value::config_build_email},
+    {"-build-warning-email",   20, package_value::config_build_warning_email},
+    {"-build-error-email",     18, package_value::config_build_error_email},
+    {"-build",                  6, package_value::buildfile},
+    {"-build2",                 7, package_value::buildfile},
+    {"-name",                   5, package_value::distribution_name},
+    {"-to-downstream-version", 22, package_value::distribution_to_downstream},
+    {"-version",                8, package_value::distribution_version}
+  };
+
+  // Return the package manifest value kind for the specified value name,
+  // only considering the exact names, or package_value::unknown if there is
+  // no match.
+  //
+  static package_value
+  find_package_value (const string& n) noexcept
+  {
+    const package_value_name* b (package_value_names);
+    const package_value_name* e (
+      b + sizeof (package_value_names) / sizeof (package_value_names[0]));
+
+    const package_value_name* i (
+      lower_bound (b, e,
+                   n.c_str (),
+                   [] (const package_value_name& v, const char* n)
+                   {
+                     return strcmp (v.name, n) < 0;
+                   }));
+
+    return i != e && strcmp (i->name, n.c_str ()) == 0
+           ? i->value
+           : package_value::unknown;
+  }
+
+  // As above but only consider the suffix-based names. Note that the suffix
+  // is expected to be preceded by a non-empty prefix.
+  //
+  static package_value
+  find_package_value_suffix (const string& n) noexcept
+  {
+    for (const package_value_suffix& s: package_value_suffixes)
+    {
+      if (n.size () > s.size &&
+          n.compare (n.size () - s.size, s.size, s.suffix) == 0)
+        return s.value;
+    }
+
+    return package_value::unknown;
+  }
+
+  // Return the package manifest value statistics entry. Note that the
+  // statistics must be enabled.
+  //
+  static manifest_parsing_stats::entry*
+  package_value_stats (const string& n, package_value pv)
+  {
+    assert (parsing_stats != nullptr);
+
+    map<string, manifest_parsing_stats::entry>& vs (
+      parsing_stats->package_values);
+
+    if (pv == package_value::build_auxiliary)
+      return &vs["*build-auxiliary*"];
+
+    if (pv != package_value::unknown &&
+        find_package_value (n) == package_value::unknown)
+    {
+      for (const package_value_suffix& s: package_value_suffixes)
+      {
+        if (s.value == pv &&
+            n.size () > s.size &&
+            n.compare (n.size () - s.size, s.size, s.suffix) == 0)
+          return &vs[string ("*") + s.suffix];
+      }
+    }
+
+    return &vs[n];
+  }
+
+  // Package manifest parsing options (complete values and flags) specified
+  // at runtime.
+  //
+  // The parsing functions are templates on the options type, so that the
+  // options known at compile time (see static_package_manifest_options
+  // below) result in a dedicated instantiation where the option checks are
+  // folded into constants and the dead branches are removed.
+  //
+  // If the errors list is specified, then the errors for the individual
+  // manifest values are collected into this list instead of being thrown
+  // (see package_manifest::validate() for details). Note that in this case
+  // the caller discards the resulting manifest and so the parsing skips
+  // building those parts of it which are not required for validation.
+  //
+  class package_manifest_options
+  {
+  public:
+    package_manifest_options (bool cv,
+                              package_manifest_flags fl,
+                              vector<manifest_parsing>* es = nullptr)
+        : cv_ (cv), fl_ (fl), es_ (es) {}
+
+    bool
+    complete_values () const {return cv_;}
+
+    bool
+    flag (package_manifest_flags f) const
+    {
+      return (fl_ & f) != package_manifest_flags::none;
+    }
+
+    vector<manifest_parsing>*
+    errors () const {return es_;}
+
+  private:
+    bool cv_;
+    package_manifest_flags fl_;
+    vector<manifest_parsing>* es_;
+  };
+
+  // Package manifest parsing options known at compile time.
+  //
+  template <bool CV, package_manifest_flags FL>
+  struct static_package_manifest_options
+  {
+    static constexpr bool
+    complete_values () {return CV;}
+
+    static constexpr bool
+    flag (package_manifest_flags f)
+    {
+      return (static_cast<uint16_t> (FL) & static_cast<uint16_t> (f)) != 0;
+    }
+
+    static constexpr vector<manifest_parsing>*
+    errors () {return nullptr;}
+  };
+
+  // Parse until next() returns end-of-manifest value.
+  //
+  template <typename O>
+  static void
+  parse_package_manifest (
+    const string& name,
+    const function<name_value ()>& next,
+    const function<package_manifest::translate_function>& translate,
+    bool iu,
+    const O& o,
+    package_manifest& m)
+  {
+    // Note: constant if the options are known at compile time.
+    //
+    const bool cv (o.complete_values ());
+
+    // If not NULL, then skip the invalid values after saving the respective
+    // errors into this list rather than throwing.
+    //
+    vector<manifest_parsing>* errors (o.errors ());
+
+    // If true, then the manifest is only validated and is discarded by the
+    // caller. In this case skip storing the postponed values, which are the
+    // most expensive to build, after parsing them.
+    //
+    // Note: constant if the options are known at compile time.
+    //
+    const bool vo (errors != nullptr);
+
+    // Note: must be called from the manifest_parsing exception handler.
+    //
+    auto skip_value = [errors] (const manifest_parsing& e)
+    {
+      if (errors == nullptr)
+        throw;
+
+      errors->push_back (e);
+    };
+
+    manifest_parsing_stats::entry* mst (
+      parsing_stats != nullptr ? &parsing_stats->package_manifests : nullptr);
+
+    stats_timer mt (mst);
+
+    name_value nv;
 
     auto bad_name ([&name, &nv](const string& d) {
         throw parsing (name, nv.name_line, nv.name_column, d);});
@@ -3550,10 +4948,7 @@ namespace bpkg
       dvs.push_back (move (nv));
     };
 
-    auto flag = [fl] (package_manifest_flags f)
-    {
-      return (fl & f) != package_manifest_flags::none;
-    };
+    auto flag = [&o] (package_manifest_flags f) {return o.flag (f);};
 
     // Based on the buildfile path specified via the `*-build[2]` value name
     // or the `build-file` value set the manifest's alt_naming flag if absent
@@ -3707,8 +5102,11 @@ namespace bpkg
     // the version value is parsed. We will also cache the requires values to
     // parse them later, after the package name is parsed.
     //
-    vector<name_value> dependencies;
-    vector<name_value> requirements;
+    // Note that the caches are sized for the typical number of values to
+    // avoid the heap allocations for them.
+    //
+    small_vector<name_value, 8> dependencies;
+    small_vector<name_value, 2> requirements;
     small_vector<name_value, 1> tests;
 
     // We will cache the descriptions and changes and their type values to
@@ -3718,7 +5116,7 @@ namespace bpkg
     optional<name_value> description_type;
     optional<name_value> package_description;
     optional<name_value> package_description_type;
-    vector<name_value>   changes;
+    small_vector<name_value, 1> changes;
     optional<name_value> changes_type;
 
     // It doesn't make sense for only emails to be specified for a package
@@ -3734,627 +5132,721 @@ namespace bpkg
     m.build_configs.emplace_back ("default");
 
     for (nv = next (); !nv.empty (); nv = next ())
+    try
     {
       string& n (nv.name);
       string& v (nv.value);
 
-      if (n == "name")
+      // Note that the build auxiliary value names are recognized after the
+      // exact value names but before the suffix-based ones (see
+      // build_auxiliary::parse_value_name() for details).
+      //
+      optional<pair<string, string>> ba;
+      package_value pv (find_package_value (n));
+
+      if (pv == package_value::unknown)
       {
-        if (!m.name.empty ())
-          bad_name ("package name redefinition");
+        if ((ba = build_auxiliary::parse_value_name (n)))
+          pv = package_value::build_auxiliary;
+        else
+          pv = find_package_value_suffix (n);
+      }
 
-        try
+      if (mst != nullptr)
+        mst->bytes += n.size () + v.size ();
+
+      stats_timer vt (mst != nullptr ? package_value_stats (n, pv) : nullptr,
+                      n.size () + v.size ());
+
+      switch (pv)
+      {
+      case package_value::name:
         {
-          m.name = package_name (move (v));
+          if (!m.name.empty ())
+            bad_name ("package name redefinition");
+
+          m.name = parse_package_name (move (nv), name);
+
+          break;
         }
-        catch (const invalid_argument& e)
+      case package_value::version:
         {
-          bad_value (string ("invalid package name: ") + e.what ());
-        }
-      }
-      else if (n == "version")
-      {
-        if (!m.version.empty ())
-          bad_name ("package version redefinition");
+          if (!m.version.empty ())
+            bad_name ("package version redefinition");
 
-        try
-        {
-          m.version = version (v);
+          m.version = parse_package_version (nv, name);
+
+          if (translate)
+          {
+            translate (m.version);
+
+            // Re-validate the version after the translation.
+            //
+            // The following description will be confusing for the end user.
+            // However, they shouldn't ever see it unless the translation
+            // function is broken.
+            //
+            if (m.version.empty ())
+              bad_value ("empty translated package version");
+
+            if (m.version.release && m.version.release->empty ())
+              bad_value ("invalid translated package version " +
+                         m.version.string () + ": earliest release");
+          }
+
+          break;
         }
-        catch (const invalid_argument& e)
+      case package_value::upstream_version:
         {
-          bad_value (string ("invalid package version: ") + e.what ());
-        }
+          if (upstream_version)
+            bad_name ("upstream package version redefinition");
 
-        // Versions like 1.2.3- are forbidden in manifest as intended to be
-        // used for version constrains rather than actual releases.
-        //
-        if (m.version.release && m.version.release->empty ())
-          bad_value ("invalid package version release");
+          if (v.empty ())
+            bad_value ("empty upstream package version");
+
+          upstream_version = move (nv);
 
-        if (translate)
+          break;
+        }
+      case package_value::type:
         {
-          translate (m.version);
+          if (m.type)
+            bad_name ("package type redefinition");
 
-          // Re-validate the version after the translation.
-          //
-          // The following description will be confusing for the end user.
-          // However, they shouldn't ever see it unless the translation
-          // function is broken.
-          //
-          if (m.version.empty ())
-            bad_value ("empty translated package version");
+          if (v.empty () || v.find (',') == 0)
+            bad_value ("empty package type");
 
-          if (m.version.release && m.version.release->empty ())
-            bad_value ("invalid translated package version " +
-                       m.version.string () + ": earliest release");
+          m.type = move (v);
+
+          break;
         }
-      }
-      else if (n == "upstream-version")
-      {
-        if (upstream_version)
-          bad_name ("upstream package version redefinition");
+      case package_value::language:
+        {
+          // Strip the language extra information, if present.
+          //
+          size_t p (v.find (','));
+          if (p != string::npos)
+            v.resize (p);
 
-        if (v.empty ())
-          bad_value ("empty upstream package version");
+          // Determine the language impl flag.
+          //
+          bool impl (false);
+          p = v.find ('=');
+          if (p != string::npos)
+          {
+            string s (trim (string (v, p + 1)));
+            if (s != "impl")
+              bad_value (!s.empty ()
+                         ? "unexpected '" + s + "' value after '='"
+                         : "expected 'impl' after '='");
 
-        upstream_version = move (nv);
-      }
-      else if (n == "type")
-      {
-        if (m.type)
-          bad_name ("package type redefinition");
+            impl = true;
 
-        if (v.empty () || v.find (',') == 0)
-          bad_value ("empty package type");
+            v.resize (p);
+          }
 
-        m.type = move (v);
-      }
-      else if (n == "language")
-      {
-        // Strip the language extra information, if present.
-        //
-        size_t p (v.find (','));
-        if (p != string::npos)
-          v.resize (p);
+          // Finally, validate and add the language.
+          //
+          trim_right (v);
 
-        // Determine the language impl flag.
-        //
-        bool impl (false);
-        p = v.find ('=');
-        if (p != string::npos)
-        {
-          string s (trim (string (v, p + 1)));
-          if (s != "impl")
-            bad_value (!s.empty ()
-                       ? "unexpected '" + s + "' value after '='"
-                       : "expected 'impl' after '='");
+          if (v.empty ())
+            bad_value ("empty package language");
+
+          if (find_if (m.languages.begin (), m.languages.end (),
+                       [&v] (const language& l) {return l.name == v;}) !=
+              m.languages.end ())
+            bad_value ("duplicate package language");
 
-          impl = true;
+          m.languages.emplace_back (move (v), impl);
 
-          v.resize (p);
+          break;
         }
+      case package_value::project:
+        {
+          if (m.project)
+            bad_name ("package project redefinition");
 
-        // Finally, validate and add the language.
-        //
-        trim_right (v);
+          try
+          {
+            m.project = package_name (move (v));
+          }
+          catch (const invalid_argument& e)
+          {
+            bad_value (string ("invalid project name: ") + e.what ());
+          }
 
-        if (v.empty ())
-          bad_value ("empty package language");
+          break;
+        }
+      case package_value::summary:
+        {
+          if (!m.summary.empty ())
+            bad_name ("package summary redefinition");
 
-        if (find_if (m.languages.begin (), m.languages.end (),
-                     [&v] (const language& l) {return l.name == v;}) !=
-            m.languages.end ())
-          bad_value ("duplicate package language");
+          if (v.empty ())
+            bad_value ("empty package summary");
 
-        m.languages.emplace_back (move (v), impl);
-      }
-      else if (n == "project")
-      {
-        if (m.project)
-          bad_name ("package project redefinition");
+          m.summary = move (v);
 
-        try
+          break;
+        }
+      case package_value::topics:
         {
-          m.project = package_name (move (v));
+          parse_list (v,
+                      m.topics,
+                      ','   /* delim */,
+                      false /* single_word */,
+                      false /* truncate */,
+                      "topics");
+
+          break;
         }
-        catch (const invalid_argument& e)
+      case package_value::keywords:
         {
-          bad_value (string ("invalid project name: ") + e.what ());
+          parse_list (v,
+                      m.keywords,
+                      ' '   /* delim */,
+                      true  /* single_word */,
+                      false /* truncate */,
+                      "keywords");
+
+          break;
         }
-      }
-      else if (n == "summary")
-      {
-        if (!m.summary.empty ())
-          bad_name ("package summary redefinition");
-
-        if (v.empty ())
-          bad_value ("empty package summary");
-
-        m.summary = move (v);
-      }
-      else if (n == "topics")
-      {
-        parse_list (v,
-                    m.topics,
-                    ','   /* delim */,
-                    false /* single_word */,
-                    false /* truncate */,
-                    "topics");
-      }
-      else if (n == "keywords")
-      {
-        parse_list (v,
-                    m.keywords,
-                    ' '   /* delim */,
-                    true  /* single_word */,
-                    false /* truncate */,
-                    "keywords");
-      }
-      else if (n == "tags")
-      {
-        parse_list (v,
-                    m.keywords,
-                    ','  /* delim */,
-                    true /* single_word */,
-                    true /* truncate */,
-                    "tags");
-      }
-      else if (n == "description")
-      {
-        if (description)
+      case package_value::tags:
         {
-          if (description->name == "description-file")
-            bad_name ("project description and description file are "
-                      "mutually exclusive");
-          else
-            bad_name ("project description redefinition");
+          parse_list (v,
+                      m.keywords,
+                      ','  /* delim */,
+                      true /* single_word */,
+                      true /* truncate */,
+                      "tags");
+
+          break;
         }
+      case package_value::description:
+        {
+          if (description)
+          {
+            if (description->name == "description-file")
+              bad_name ("project description and description file are "
+                        "mutually exclusive");
+            else
+              bad_name ("project description redefinition");
+          }
 
-        if (v.empty ())
-          bad_value ("empty project description");
+          if (v.empty ())
+            bad_value ("empty project description");
 
-        description = move (nv);
-      }
-      else if (n == "description-file")
-      {
-        if (flag (package_manifest_flags::forbid_file))
-          bad_name ("project description file not allowed");
+          description = move (nv);
 
-        if (description)
-        {
-          if (description->name == "description-file")
-            bad_name ("project description file redefinition");
-          else
-            bad_name ("project description file and description are "
-                      "mutually exclusive");
+          break;
         }
+      case package_value::description_file:
+        {
+          if (flag (package_manifest_flags::forbid_file))
+            bad_name ("project description file not allowed");
 
-        description = move (nv);
-      }
-      else if (n == "description-type")
-      {
-        if (description_type)
-          bad_name ("project description type redefinition");
+          if (description)
+          {
+            if (description->name == "description-file")
+              bad_name ("project description file redefinition");
+            else
+              bad_name ("project description file and description are "
+                        "mutually exclusive");
+          }
 
-        description_type = move (nv);
-      }
-      else if (n == "package-description")
-      {
-        if (package_description)
+          description = move (nv);
+
+          break;
+        }
+      case package_value::description_type:
         {
-          if (package_description->name == "package-description-file")
-            bad_name ("package description and description file are "
-                      "mutually exclusive");
-          else
-            bad_name ("package description redefinition");
+          if (description_type)
+            bad_name ("project description type redefinition");
+
+          description_type = move (nv);
+
+          break;
         }
+      case package_value::package_description:
+        {
+          if (package_description)
+          {
+            if (package_description->name == "package-description-file")
+              bad_name ("package description and description file are "
+                        "mutually exclusive");
+            else
+              bad_name ("package description redefinition");
+          }
 
-        if (v.empty ())
-          bad_value ("empty package description");
+          if (v.empty ())
+            bad_value ("empty package description");
 
-        package_description = move (nv);
-      }
-      else if (n == "package-description-file")
-      {
-        if (flag (package_manifest_flags::forbid_file))
-          bad_name ("package description file not allowed");
+          package_description = move (nv);
 
-        if (package_description)
+          break;
+        }
+      case package_value::package_description_file:
         {
-          if (package_description->name == "package-description-file")
-            bad_name ("package description file redefinition");
-          else
-            bad_name ("package description file and description are "
-                      "mutually exclusive");
+          if (flag (package_manifest_flags::forbid_file))
+            bad_name ("package description file not allowed");
+
+          if (package_description)
+          {
+            if (package_description->name == "package-description-file")
+              bad_name ("package description file redefinition");
+            else
+              bad_name ("package description file and description are "
+                        "mutually exclusive");
+          }
+
+          package_description = move (nv);
+
+          break;
         }
+      case package_value::package_description_type:
+        {
+          if (package_description_type)
+            bad_name ("package description type redefinition");
 
-        package_description = move (nv);
-      }
-      else if (n == "package-description-type")
-      {
-        if (package_description_type)
-          bad_name ("package description type redefinition");
+          package_description_type = move (nv);
 
-        package_description_type = move (nv);
-      }
-      else if (n == "changes")
-      {
-        if (v.empty ())
-          bad_value ("empty package changes specification");
+          break;
+        }
+      case package_value::changes:
+        {
+          if (v.empty ())
+            bad_value ("empty package changes specification");
 
-        changes.emplace_back (move (nv));
-      }
-      else if (n == "changes-file")
-      {
-        if (flag (package_manifest_flags::forbid_file))
-          bad_name ("package changes-file not allowed");
+          changes.emplace_back (move (nv));
 
-        changes.emplace_back (move (nv));
-      }
-      else if (n == "changes-type")
-      {
-        if (changes_type)
-          bad_name ("package changes type redefinition");
+          break;
+        }
+      case package_value::changes_file:
+        {
+          if (flag (package_manifest_flags::forbid_file))
+            bad_name ("package changes-file not allowed");
 
-        changes_type = move (nv);
-      }
-      else if (n == "url")
-      {
-        if (m.url)
-          bad_name ("project url redefinition");
+          changes.emplace_back (move (nv));
 
-        m.url = parse_url (v, "project");
-      }
-      else if (n == "email")
-      {
-        parse_email (nv, m.email, "project");
-      }
-      else if (n == "doc-url")
-      {
-        if (m.doc_url)
-          bad_name ("doc url redefinition");
+          break;
+        }
+      case package_value::changes_type:
+        {
+          if (changes_type)
+            bad_name ("package changes type redefinition");
 
-        m.doc_url = parse_url (v, "doc");
-      }
-      else if (n == "src-url")
-      {
-        if (m.src_url)
-          bad_name ("src url redefinition");
+          changes_type = move (nv);
 
-        m.src_url = parse_url (v, "src");
-      }
-      else if (n == "package-url")
-      {
-        if (m.package_url)
-          bad_name ("package url redefinition");
+          break;
+        }
+      case package_value::url:
+        {
+          if (m.url)
+            bad_name ("project url redefinition");
 
-        m.package_url = parse_url (v, "package");
-      }
-      else if (n == "package-email")
-      {
-        parse_email (nv, m.package_email, "package");
-      }
-      else if (n == "build-email")
-      {
-        parse_email (nv, m.build_email, "build", true /* empty */);
-      }
-      else if (n == "build-warning-email")
-      {
-        parse_email (nv, m.build_warning_email, "build warning");
-      }
-      else if (n == "build-error-email")
-      {
-        parse_email (nv, m.build_error_email, "build error");
-      }
-      else if (n == "priority")
-      {
-        if (m.priority)
-          bad_name ("package priority redefinition");
+          m.url = parse_url (v, "project");
 
-        auto vc (parser::split_comment (v));
-        strings::const_iterator b (priority_names.begin ());
-        strings::const_iterator e (priority_names.end ());
-        strings::const_iterator i (find (b, e, vc.first));
+          break;
+        }
+      case package_value::email:
+        {
+          parse_email (nv, m.email, "project");
 
-        if (i == e)
-          bad_value ("invalid package priority");
+          break;
+        }
+      case package_value::doc_url:
+        {
+          if (m.doc_url)
+            bad_name ("doc url redefinition");
 
-        m.priority =
-          priority (static_cast<priority::value_type> (i - b),
-                    move (vc.second));
-      }
-      else if (n == "license")
-      {
-        auto vc (parser::split_comment (v));
-        licenses l (move (vc.second));
+          m.doc_url = parse_url (v, "doc");
 
-        list_parser lp (vc.first.begin (), vc.first.end ());
-        for (string lv (lp.next ()); !lv.empty (); lv = lp.next ())
+          break;
+        }
+      case package_value::src_url:
         {
-          // Reserve the license schemes for the future use and only recognize
-          // the 'other' scheme for now, if specified. By default, the 'spdx'
-          // scheme is implied.
-          //
-          // Note that if the substring that precedes ':' contains the
-          // 'DocumentRef-' substring, then this is not a license scheme but
-          // the license is a SPDX License Expression (see SPDX user defined
-          // license reference for details).
-          //
-          size_t p (lv.find (':'));
+          if (m.src_url)
+            bad_name ("src url redefinition");
 
-          if (p != string::npos            &&
-              lv.find ("DocumentRef-") > p &&
-              lv.compare (0, p, "other") != 0)
-            bad_value ("invalid package license scheme");
+          m.src_url = parse_url (v, "src");
 
-          l.push_back (move (lv));
+          break;
         }
+      case package_value::package_url:
+        {
+          if (m.package_url)
+            bad_name ("package url redefinition");
 
-        if (l.empty ())
-          bad_value ("empty package license specification");
+          m.package_url = parse_url (v, "package");
 
-        m.license_alternatives.push_back (move (l));
-      }
-      else if (n == "depends")
-      {
-        dependencies.push_back (move (nv));
-      }
-      else if (n == "requires")
-      {
-        requirements.push_back (move (nv));
-      }
-      else if (n == "builds")
-      {
-        m.builds.push_back (
-          parse_build_class_expr (nv, m.builds.empty (), name));
-      }
-      else if (n == "build-include")
-      {
-        m.build_constraints.push_back (
-          parse_build_constraint (nv, false /* exclusion */, name));
-      }
-      else if (n == "build-exclude")
-      {
-        m.build_constraints.push_back (
-          parse_build_constraint (nv, true /* exclusion */, name));
-      }
-      else if (optional<pair<string, string>> ba =
-               build_auxiliary::parse_value_name (n))
-      {
-        if (ba->first.empty ()) // build-auxiliary*?
+          break;
+        }
+      case package_value::package_email:
         {
-          parse_build_auxiliary (nv, move (ba->second), m.build_auxiliaries);
+          parse_email (nv, m.package_email, "package");
+
+          break;
         }
-        else                    // *-build-auxiliary*
+      case package_value::build_email:
         {
-          build_package_config& bc (build_conf (move (ba->first)));
-          parse_build_auxiliary (nv, move (ba->second), bc.auxiliaries);
+          parse_email (nv, m.build_email, "build", true /* empty */);
+
+          break;
         }
-      }
-      else if (n == "build-bot")
-      {
-        parse_build_bot (nv, name, m.build_bot_keys);
-      }
-      else if (n.size () > 13 &&
-               n.compare (n.size () - 13, 13, "-build-config") == 0)
-      {
-        auto vc (parser::split_comment (v));
+      case package_value::build_warning_email:
+        {
+          parse_email (nv, m.build_warning_email, "build warning");
 
-        n.resize (n.size () - 13);
+          break;
+        }
+      case package_value::build_error_email:
+        {
+          parse_email (nv, m.build_error_email, "build error");
 
-        build_package_config& bc (build_conf (move (n)));
+          break;
+        }
+      case package_value::priority:
+        {
+          if (m.priority)
+            bad_name ("package priority redefinition");
 
-        if (!bc.arguments.empty () || !bc.comment.empty ())
-          bad_name ("build configuration redefinition");
+          auto vc (parser::split_comment (v));
+          strings::const_iterator b (priority_names.begin ());
+          strings::const_iterator e (priority_names.end ());
+          strings::const_iterator i (find (b, e, vc.first));
 
-        bc.arguments = move (vc.first);
-        bc.comment = move (vc.second);
-      }
-      else if (n.size () > 7 && n.compare (n.size () - 7, 7, "-builds") == 0)
-      {
-        n.resize (n.size () - 7);
+          if (i == e)
+            bad_value ("invalid package priority");
 
-        build_package_config& bc (build_conf (move (n)));
+          m.priority =
+            priority (static_cast<priority::value_type> (i - b),
+                      move (vc.second));
 
-        bc.builds.push_back (
-          parse_build_class_expr (nv, bc.builds.empty (), name));
-      }
-      else if (n.size () > 14 &&
-               n.compare (n.size () - 14, 14, "-build-include") == 0)
-      {
-        n.resize (n.size () - 14);
+          break;
+        }
+      case package_value::license:
+        {
+          auto vc (parser::split_comment (v));
+          licenses l (move (vc.second));
 
-        build_package_config& bc (build_conf (move (n)));
+          list_parser lp (vc.first.begin (), vc.first.end ());
+          for (string lv (lp.next ()); !lv.empty (); lv = lp.next ())
+          {
+            // Reserve the license schemes for the future use and only
+            // recognize the 'other' scheme for now, if specified. By default,
+            // the 'spdx' scheme is implied.
+            //
+            // Note that if the substring that precedes ':' contains the
+            // 'DocumentRef-' substring, then this is not a license scheme but
+            // the license is a SPDX License Expression (see SPDX user defined
+            // license reference for details).
+            //
+            size_t p (lv.find (':'));
 
-        bc.constraints.push_back (
-          parse_build_constraint (nv, false /* exclusion */, name));
-      }
-      else if (n.size () > 14 &&
-               n.compare (n.size () - 14, 14, "-build-exclude") == 0)
-      {
-        n.resize (n.size () - 14);
+            if (p != string::npos            &&
+                lv.find ("DocumentRef-") > p &&
+                lv.compare (0, p, "other") != 0)
+              bad_value ("invalid package license scheme");
 
-        build_package_config& bc (build_conf (move (n)));
+            l.push_back (move (lv));
+          }
 
-        bc.constraints.push_back (
-          parse_build_constraint (nv, true /* exclusion */, name));
-      }
-      else if (n.size () > 10 &&
-               n.compare (n.size () - 10, 10, "-build-bot") == 0)
-      {
-        n.resize (n.size () - 10);
+          if (l.empty ())
+            bad_value ("empty package license specification");
 
-        build_package_config& bc (build_conf (move (n)));
-        parse_build_bot (nv, name, bc.bot_keys);
-      }
-      else if (n.size () > 12 &&
-               n.compare (n.size () - 12, 12, "-build-email") == 0)
-      {
-        n.resize (n.size () - 12);
-        build_config_emails.push_back (move (nv));
-      }
-      else if (n.size () > 20 &&
-               n.compare (n.size () - 20, 20, "-build-warning-email") == 0)
-      {
-        n.resize (n.size () - 20);
-        build_config_warning_emails.push_back (move (nv));
-      }
-      else if (n.size () > 18 &&
-               n.compare (n.size () - 18, 18, "-build-error-email") == 0)
-      {
-        n.resize (n.size () - 18);
-        build_config_error_emails.push_back (move (nv));
-      }
-      else if (n == "tests" || n == "examples" || n == "benchmarks")
-      {
-        tests.push_back (move (nv));
-      }
-      else if (n == "bootstrap-build" || n == "bootstrap-build2")
-      {
-        if (optional<string> e = alt_naming (n))
-          bad_name (*e);
+          m.license_alternatives.push_back (move (l));
 
-        if (m.bootstrap_build)
-          bad_name ("package " + n + " redefinition");
+          break;
+        }
+      case package_value::depends:
+        {
+          dependencies.push_back (move (nv));
 
-        m.bootstrap_build = move (v);
-      }
-      else if (n == "root-build" || n == "root-build2")
-      {
-        if (optional<string> e = alt_naming (n))
-          bad_name (*e);
+          break;
+        }
+      case package_value::requires:
+        {
+          requirements.push_back (move (nv));
 
-        if (m.root_build)
-          bad_name ("package " + n + " redefinition");
+          break;
+        }
+      case package_value::builds:
+        {
+          m.builds.push_back (
+            parse_build_class_expr (nv, m.builds.empty (), name));
 
-        m.root_build = move (v);
-      }
-      else if ((n.size () > 6 && n.compare (n.size () - 6, 6, "-build") == 0) ||
-               (n.size () > 7 && n.compare (n.size () - 7, 7, "-build2") == 0))
-      {
-        string err;
-        if (optional<path> p = parse_buildfile_path (move (n), err))
-          m.buildfiles.push_back (buildfile (move (*p), move (v)));
-        else
-          bad_name (err);
-      }
-      else if (n == "build-file")
-      {
-        if (flag (package_manifest_flags::forbid_file))
-          bad_name ("package build-file not allowed");
+          break;
+        }
+      case package_value::build_include:
+        {
+          m.build_constraints.push_back (
+            parse_build_constraint (nv, false /* exclusion */, name));
 
-        // Verify that the buildfile extension is either build or build2.
-        //
-        if ((v.size () > 6 && v.compare (v.size () - 6, 6, ".build") == 0) ||
-            (v.size () > 7 && v.compare (v.size () - 7, 7, ".build2") == 0))
+          break;
+        }
+      case package_value::build_exclude:
         {
-          string err;
-          if (optional<path> p = parse_buildfile_path (move (v), err))
-          {
-            // Verify that the resulting path differs from bootstrap and root.
-            //
-            const string& s (p->string ());
-            if (s == "bootstrap" || s == "root")
-              bad_value (s + " not allowed");
+          m.build_constraints.push_back (
+            parse_build_constraint (nv, true /* exclusion */, name));
 
-            m.buildfile_paths.push_back (move (*p));
+          break;
+        }
+      case package_value::build_auxiliary:
+        {
+          if (ba->first.empty ()) // build-auxiliary*?
+          {
+            parse_build_auxiliary (nv, move (ba->second), m.build_auxiliaries);
           }
-          else
-            bad_value (err);
+          else                    // *-build-auxiliary*
+          {
+            build_package_config& bc (build_conf (move (ba->first)));
+            parse_build_auxiliary (nv, move (ba->second), bc.auxiliaries);
+          }
+
+          break;
         }
-        else
-          bad_value ("path with build or build2 extension expected");
+      case package_value::build_bot:
+        {
+          parse_build_bot (nv, name, m.build_bot_keys);
 
-      }
-      else if (n.size () > 5 && n.compare (n.size () - 5, 5, "-name") == 0)
-      {
-        add_distribution (
-          parse_distribution (move (n), n.size () - 5, move (v)),
-          false /* unique */);
-      }
-      // Note: must precede the check for the "-version" suffix.
-      //
-      else if (n.size () > 22 &&
-               n.compare (n.size () - 22, 22, "-to-downstream-version") == 0)
-      {
-        add_distribution (
-          parse_distribution (move (n), n.size () - 22, move (v)),
-          false /* unique */);
-      }
-      // Note: must follow the check for "upstream-version".
-      //
-      else if (n.size () > 8 && n.compare (n.size () - 8, 8, "-version") == 0)
-      {
-        // If the value is forbidden then throw, but only after the name is
-        // validated. Thus, check for that before we move the value from.
-        //
-        bool bad (v == "$" &&
-                  flag (package_manifest_flags::forbid_incomplete_values));
+          break;
+        }
+      case package_value::config_build_config:
+        {
+          auto vc (parser::split_comment (v));
 
-        // Can throw.
-        //
-        distribution_name_value d (
-          parse_distribution (move (n), n.size () - 8, move (v)));
+          n.resize (n.size () - 13);
 
-        if (bad)
-          bad_value ("$ not allowed");
+          build_package_config& bc (build_conf (move (n)));
 
-        add_distribution (move (d), true /* unique */);
-      }
-      else if (n == "location")
-      {
-        if (flag (package_manifest_flags::forbid_location))
-          bad_name ("package location not allowed");
+          if (!bc.arguments.empty () || !bc.comment.empty ())
+            bad_name ("build configuration redefinition");
 
-        if (m.location)
-          bad_name ("package location redefinition");
+          bc.arguments = move (vc.first);
+          bc.comment = move (vc.second);
 
-        try
+          break;
+        }
+      case package_value::config_builds:
         {
-          path l (v);
+          n.resize (n.size () - 7);
 
-          if (l.empty ())
-            bad_value ("empty package location");
+          build_package_config& bc (build_conf (move (n)));
 
-          if (l.absolute ())
-            bad_value ("absolute package location");
+          bc.builds.push_back (
+            parse_build_class_expr (nv, bc.builds.empty (), name));
 
-          m.location = move (l);
+          break;
         }
-        catch (const invalid_path&)
+      case package_value::config_build_include:
         {
-          bad_value ("invalid package location");
-        }
-      }
-      else if (n == "sha256sum")
-      {
-        if (flag (package_manifest_flags::forbid_sha256sum))
-          bad_name ("package sha256sum not allowed");
+          n.resize (n.size () - 14);
 
-        if (m.sha256sum)
-          bad_name ("package sha256sum redefinition");
+          build_package_config& bc (build_conf (move (n)));
 
-        if (!valid_sha256 (v))
-          bad_value ("invalid package sha256sum");
+          bc.constraints.push_back (
+            parse_build_constraint (nv, false /* exclusion */, name));
 
-        m.sha256sum = move (v);
-      }
-      else if (n == "fragment")
-      {
-        if (flag (package_manifest_flags::forbid_fragment))
-          bad_name ("package repository fragment not allowed");
+          break;
+        }
+      case package_value::config_build_exclude:
+        {
+          n.resize (n.size () - 14);
 
-        if (m.fragment)
-          bad_name ("package repository fragment redefinition");
+          build_package_config& bc (build_conf (move (n)));
 
-        if (v.empty ())
-          bad_value ("empty package repository fragment");
+          bc.constraints.push_back (
+            parse_build_constraint (nv, true /* exclusion */, name));
 
-        m.fragment = move (v);
+          break;
+        }
+      case package_value::config_build_bot:
+        {
+          n.resize (n.size () - 10);
+
+          build_package_config& bc (build_conf (move (n)));
+          parse_build_bot (nv, name, bc.bot_keys);
+
+          break;
+        }
+      case package_value::config_build_email:
+        {
+          n.resize (n.size () - 12);
+          build_config_emails.push_back (move (nv));
+
+          break;
+        }
+      case package_value::config_build_warning_email:
+        {
+          n.resize (n.size () - 20);
+          build_config_warning_emails.push_back (move (nv));
+
+          break;
+        }
+      case package_value::config_build_error_email:
+        {
+          n.resize (n.size () - 18);
+          build_config_error_emails.push_back (move (nv));
+
+          break;
+        }
+      case package_value::tests:
+        {
+          tests.push_back (move (nv));
+
+          break;
+        }
+      case package_value::bootstrap_build:
+        {
+          if (optional<string> e = alt_naming (n))
+            bad_name (*e);
+
+          if (m.bootstrap_build)
+            bad_name ("package " + n + " redefinition");
+
+          m.bootstrap_build = move (v);
+
+          break;
+        }
+      case package_value::root_build:
+        {
+          if (optional<string> e = alt_naming (n))
+            bad_name (*e);
+
+          if (m.root_build)
+            bad_name ("package " + n + " redefinition");
+
+          m.root_build = move (v);
+
+          break;
+        }
+      case package_value::buildfile:
+        {
+          string err;
+          if (optional<path> p = parse_buildfile_path (move (n), err))
+            m.buildfiles.push_back (buildfile (move (*p), move (v)));
+          else
+            bad_name (err);
+
+          break;
+        }
+      case package_value::build_file:
+        {
+          if (flag (package_manifest_flags::forbid_file))
+            bad_name ("package build-file not allowed");
+
+          // Verify that the buildfile extension is either build or build2.
+          //
+          if ((v.size () > 6 && v.compare (v.size () - 6, 6, ".build") == 0) ||
+              (v.size () > 7 && v.compare (v.size () - 7, 7, ".build2") == 0))
+          {
+            string err;
+            if (optional<path> p = parse_buildfile_path (move (v), err))
+            {
+              // Verify that the resulting path differs from bootstrap and
+              // root.
+              //
+              const string& s (p->string ());
+              if (s == "bootstrap" || s == "root")
+                bad_value (s + " not allowed");
+
+              m.buildfile_paths.push_back (move (*p));
+            }
+            else
+              bad_value (err);
+          }
+          else
+            bad_value ("path with build or build2 extension expected");
+
+          break;
+        }
+      case package_value::distribution_name:
+        {
+          add_distribution (
+            parse_distribution (move (n), n.size () - 5, move (v)),
+            false /* unique */);
+
+          break;
+        }
+      case package_value::distribution_to_downstream:
+        {
+          add_distribution (
+            parse_distribution (move (n), n.size () - 22, move (v)),
+            false /* unique */);
+
+          break;
+        }
+      case package_value::distribution_version:
+        {
+          // If the value is forbidden then throw, but only after the name is
+          // validated. Thus, check for that before we move the value from.
+          //
+          bool bad (v == "$" &&
+                    flag (package_manifest_flags::forbid_incomplete_values));
+
+          // Can throw.
+          //
+          distribution_name_value d (
+            parse_distribution (move (n), n.size () - 8, move (v)));
+
+          if (bad)
+            bad_value ("$ not allowed");
+
+          add_distribution (move (d), true /* unique */);
+
+          break;
+        }
+      case package_value::location:
+        {
+          if (flag (package_manifest_flags::forbid_location))
+            bad_name ("package location not allowed");
+
+          if (m.location)
+            bad_name ("package location redefinition");
+
+          m.location = parse_package_location (move (nv), name);
+
+          break;
+        }
+      case package_value::sha256sum:
+        {
+          if (flag (package_manifest_flags::forbid_sha256sum))
+            bad_name ("package sha256sum not allowed");
+
+          if (m.sha256sum)
+            bad_name ("package sha256sum redefinition");
+
+          m.sha256sum = parse_package_sha256sum (move (nv), name);
+
+          break;
+        }
+      case package_value::fragment:
+        {
+          if (flag (package_manifest_flags::forbid_fragment))
+            bad_name ("package repository fragment not allowed");
+
+          if (m.fragment)
+            bad_name ("package repository fragment redefinition");
+
+          if (v.empty ())
+            bad_value ("empty package repository fragment");
+
+          m.fragment = move (v);
+
+          break;
+        }
+      case package_value::unknown:
+        {
+          if (!iu)
+            bad_name ("unknown name '" + n + "' in package manifest");
+
+          break;
+        }
       }
-      else if (!iu)
-        bad_name ("unknown name '" + n + "' in package manifest");
+    }
+    catch (const manifest_parsing& e)
+    {
+      skip_value (e);
     }
 
     // Verify all non-optional values were specified.
@@ -4506,8 +5998,17 @@ namespace bpkg
     // value in unspecified state but we can still check for the value
     // presence.
     //
+    m.changes.reserve (changes.size ());
+
     for (name_value& c: changes)
+    try
     {
+      stats_timer t (mst != nullptr
+                     ? package_value_stats (c.name, package_value::changes)
+                     : nullptr,
+                     0 /* bytes */,
+                     0 /* count */);
+
       // Move the changes_type value from for the last changes entry.
       //
       m.changes.push_back (
@@ -4517,13 +6018,20 @@ namespace bpkg
                           : move (changes_type)),
                          "changes"));
     }
+    catch (const manifest_parsing& e)
+    {
+      skip_value (e);
+    }
 
     // If there are multiple changes and the changes type is not explicitly
     // specified, then verify that all changes effective types are the same.
     // Note that in the "ignore unknown" mode there can be unresolved
-    // effective types which we just skip.
+    // effective types which we just skip. Also skip the verification if
+    // some invalid changes have been skipped (see above).
     //
-    if (changes.size () > 1 && !changes_type)
+    if (changes.size () > 1                  &&
+        !changes_type                        &&
+        m.changes.size () == changes.size ())
     {
       optional<text_type> type;
 
@@ -4631,10 +6139,20 @@ namespace bpkg
 
     // Parse the regular dependencies.
     //
+    if (!vo)
+      m.dependencies.reserve (dependencies.size ());
+
     for (name_value& d: dependencies)
+    try
     {
       nv = move (d); // Restore as bad_value() uses its line/column.
 
+      stats_timer t (mst != nullptr
+                     ? package_value_stats (nv.name, package_value::depends)
+                     : nullptr,
+                     0 /* bytes */,
+                     0 /* count */);
+
       // Parse dependency alternatives.
       //
       try
@@ -4651,49 +6169,105 @@ namespace bpkg
             d = complete_constraint (move (d));
         }
 
-        m.dependencies.push_back (move (das));
+        if (!vo)
+          m.dependencies.push_back (move (das));
       }
       catch (const invalid_argument& e)
       {
         bad_value (e.what ());
       }
     }
+    catch (const manifest_parsing& e)
+    {
+      skip_value (e);
+    }
 
     // Parse the requirements.
     //
+    // Note that when only validating, we also skip converting the parsed
+    // dependency alternatives into the requirement alternatives (see
+    // requirement_alternatives for details).
+    //
+    if (!vo)
+      m.requirements.reserve (requirements.size ());
+
     for (const name_value& r: requirements)
+    try
+    {
+      stats_timer t (mst != nullptr
+                     ? package_value_stats (r.name, package_value::requires)
+                     : nullptr,
+                     0 /* bytes */,
+                     0 /* count */);
+
+      if (!vo)
+      {
+        m.requirements.push_back (
+          requirement_alternatives (r.value,
+                                    m.name,
+                                    name,
+                                    r.value_line,
+                                    r.value_column));
+      }
+      else
+      {
+        string c;
+        bool bt;
+        parse_requirement_alternatives (r.value,
+                                        m.name,
+                                        name,
+                                        r.value_line,
+                                        r.value_column,
+                                        c,
+                                        bt);
+      }
+    }
+    catch (const manifest_parsing& e)
     {
-      m.requirements.push_back (
-        requirement_alternatives (r.value,
-                                  m.name,
-                                  name,
-                                  r.value_line,
-                                  r.value_column));
+      skip_value (e);
     }
 
     // Parse the test dependencies.
     //
+    if (!vo)
+      m.tests.reserve (tests.size ());
+
     for (name_value& t: tests)
+    try
     {
       nv = move (t); // Restore as bad_value() uses its line/column.
 
+      stats_timer st (mst != nullptr
+                      ? package_value_stats (nv.name, package_value::tests)
+                      : nullptr,
+                      0 /* bytes */,
+                      0 /* count */);
+
       try
       {
-        m.tests.push_back (
+        test_dependency td (
           complete_constraint (
             test_dependency (move (nv.value),
                              to_test_dependency_type (nv.name))));
+
+        if (!vo)
+          m.tests.push_back (move (td));
       }
       catch (const invalid_argument& e)
       {
         bad_value (e.what ());
       }
     }
+    catch (const manifest_parsing& e)
+    {
+      skip_value (e);
+    }
 
     // Now, when the version manifest value is parsed, we complete the
-    // <distribution>-version values, if requested.
+    // <distribution>-version values, if requested. Note that this can't fail
+    // and so we skip it when only validating.
     //
-    if (cv)
+    if (cv && !vo)
     {
       for (distribution_name_value& nv: m.distribution_values)
       {
@@ -4743,8 +6317,11 @@ namespace bpkg
         //        be sure that these values are always present for package
         //        manifest lists.
         //bad_name ("no package changes type specified");
-        for (typed_text_file& c: m.changes)
-          c.type = "text/plain";
+        if (!vo)
+        {
+          for (typed_text_file& c: m.changes)
+            c.type = "text/plain";
+        }
       }
     }
 
@@ -4753,14 +6330,14 @@ namespace bpkg
       bad_name ("no package bootstrap build specified");
   }
 
+  template <typename O>
   static void
   parse_package_manifest (
     parser& p,
     name_value nv,
     const function<package_manifest::translate_function>& tf,
     bool iu,
-    bool cv,
-    package_manifest_flags fl,
+    const O& o,
     package_manifest& m)
   {
     // Make sure this is the start and we support the version.
@@ -4779,25 +6356,38 @@ namespace bpkg
                             [&p] () {return p.next ();},
                             tf,
                             iu,
-                            cv,
-                            fl,
+                            o,
                             m);
   }
 
+  // Note: the pkg package manifest list elements are the most common case
+  // (packages.manifest files may contain thousands of them), so parse them
+  // with the options known at compile time.
+  //
+  using pkg_package_manifest_options =
+    static_package_manifest_options<
+      false /* complete_values */,
+      static_cast<package_manifest_flags> (
+        static_cast<uint16_t> (package_manifest_flags::forbid_file)          |
+        static_cast<uint16_t> (package_manifest_flags::forbid_fragment)      |
+        static_cast<uint16_t> (
+          package_manifest_flags::forbid_incomplete_values)                  |
+        static_cast<uint16_t> (package_manifest_flags::require_location)     |
+        static_cast<uint16_t> (package_manifest_flags::require_text_type)    |
+        static_cast<uint16_t> (
+          package_manifest_flags::require_bootstrap_build))>;
+
   package_manifest
   pkg_package_manifest (parser& p, name_value nv, bool iu)
   {
-    return package_manifest (
-      p,
-      move (nv),
-      iu,
-      false /* complete_values */,
-      package_manifest_flags::forbid_file              |
-      package_manifest_flags::forbid_fragment          |
-      package_manifest_flags::forbid_incomplete_values |
-      package_manifest_flags::require_location         |
-      package_manifest_flags::require_text_type        |
-      package_manifest_flags::require_bootstrap_build);
+    package_manifest r;
+    parse_package_manifest (p,
+                            move (nv),
+                            function<package_manifest::translate_function> (),
+                            iu,
+                            pkg_package_manifest_options (),
+                            r);
+    return r;
   }
 
   // package_manifest
@@ -4809,7 +6399,12 @@ namespace bpkg
                     bool cv,
                     package_manifest_flags fl)
   {
-    parse_package_manifest (p, p.next (), tf, iu, cv, fl, *this);
+    parse_package_manifest (p,
+                            p.next (),
+                            tf,
+                            iu,
+                            package_manifest_options (cv, fl),
+                            *this);
 
     // Make sure this is the end.
     //
@@ -4839,8 +6434,7 @@ namespace bpkg
                             },
                             tf,
                             iu,
-                            cv,
-                            fl,
+                            package_manifest_options (cv, fl),
                             *this);
   }
 
@@ -4866,8 +6460,12 @@ namespace bpkg
                     bool cv,
                     package_manifest_flags fl)
   {
-    parse_package_manifest (
-      p, move (nv), function<translate_function> (), iu, cv, fl, *this);
+    parse_package_manifest (p,
+                            move (nv),
+                            function<translate_function> (),
+                            iu,
+                            package_manifest_options (cv, fl),
+                            *this);
   }
 
   strings package_manifest::
@@ -4887,16 +6485,193 @@ namespace bpkg
     return r;
   }
 
+  // Package manifest value override pre-parsed independently from the
+  // manifest it is applied to.
+  //
+  // Note that if parsing fails, then the exception is saved and is only
+  // thrown while applying the override, at the point where the value would
+  // have been parsed by the single-pass implementation. This way the
+  // diagnostics doesn't depend on whether the overrides are pre-parsed.
+  //
+  struct package_manifest_overrides::value
+  {
+    package_value kind = package_value::unknown;
+
+    // Length of the build configuration name for the build auxiliary
+    // configuration overrides (0 for the common ones).
+    //
+    size_t config_size = 0;
+
+    optional<build_class_expr> builds;
+    optional<build_constraint> constraint;
+    optional<bpkg::email>      email;
+    optional<build_auxiliary>  auxiliary;
+
+    exception_ptr error;
+  };
+
+  // Pre-parse the package manifest value overrides.
+  //
+  static vector<package_manifest_overrides::value>
+  parse_overrides (const vector<manifest_name_value>& nvs, const string& name)
+  {
+    vector<package_manifest_overrides::value> r;
+    r.reserve (nvs.size ());
+
+    // Names of the build configurations for which the *-builds overrides
+    // are already encountered. Note that the empty name stands for the
+    // common builds overrides.
+    //
+    strings bcs;
+
+    auto first_builds = [&bcs] (string&& c)
+    {
+      if (find (bcs.begin (), bcs.end (), c) != bcs.end ())
+        return false;
+
+      bcs.push_back (move (c));
+      return true;
+    };
+
+    for (const manifest_name_value& nv: nvs)
+    {
+      r.emplace_back ();
+      package_manifest_overrides::value& v (r.back ());
+
+      const string& n (nv.name);
+
+      v.kind = find_package_value (n);
+
+      if (v.kind == package_value::unknown)
+        v.kind = find_package_value_suffix (n);
+
+      try
+      {
+        switch (v.kind)
+        {
+        case package_value::builds:
+          {
+            v.builds = parse_build_class_expr (nv,
+                                               first_builds (string ()),
+                                               name);
+            break;
+          }
+        case package_value::config_builds:
+          {
+            v.builds = parse_build_class_expr (
+              nv,
+              first_builds (string (n, 0, n.size () - 7)),
+              name);
+
+            break;
+          }
+        case package_value::build_include:
+        case package_value::config_build_include:
+          {
+            v.constraint =
+              parse_build_constraint (nv, false /* exclusion */, name);
+
+            break;
+          }
+        case package_value::build_exclude:
+        case package_value::config_build_exclude:
+          {
+            v.constraint =
+              parse_build_constraint (nv, true /* exclusion */, name);
+
+            break;
+          }
+        case package_value::build_email:
+          {
+            v.email = parse_email (nv, "build", name, true /* empty */);
+            break;
+          }
+        case package_value::build_warning_email:
+          {
+            v.email = parse_email (nv, "build warning", name);
+            break;
+          }
+        case package_value::build_error_email:
+          {
+            v.email = parse_email (nv, "build error", name);
+            break;
+          }
+        case package_value::config_build_email:
+          {
+            v.email = parse_email (
+              nv, "build configuration", name, true /* empty */);
+
+            break;
+          }
+        case package_value::config_build_warning_email:
+          {
+            v.email = parse_email (nv, "build configuration warning", name);
+            break;
+          }
+        case package_value::config_build_error_email:
+          {
+            v.email = parse_email (nv, "build configuration error", name);
+            break;
+          }
+        case package_value::build_bot:
+        case package_value::config_build_bot:
+        case package_value::config_build_config:
+          {
+            // Parsed while applying (see override() for details).
+            //
+            break;
+          }
+        default:
+          {
+            // Note that the build auxiliary value names are only recognized
+            // if the name doesn't match any of the exact or suffix-based
+            // names.
+            //
+            optional<pair<string, string>> ba (
+              build_auxiliary::parse_value_name (n));
+
+            if (!ba)
+            {
+              v.kind = package_value::unknown;
+
+              string d ("cannot override '" + n + "' value");
+
+              throw !name.empty ()
+                    ? parsing (name, nv.name_line, nv.name_column, d)
+                    : parsing (d);
+            }
+
+            v.kind = package_value::build_auxiliary;
+            v.config_size = ba->first.size ();
+            v.auxiliary = parse_build_auxiliary (nv, move (ba->second), name);
+            break;
+          }
+        }
+      }
+      catch (const manifest_parsing&)
+      {
+        v.error = current_exception ();
+      }
+    }
+
+    return r;
+  }
+
+  // Apply the pre-parsed package manifest value overrides.
+  //
   // If validate_only is true, then the package manifest is assumed to be
   // default constructed and is used as a storage for convenience of the
   // validation implementation.
   //
   static void
   override (const vector<manifest_name_value>& nvs,
+            const vector<package_manifest_overrides::value>& vs,
             const string& name,
             package_manifest& m,
             bool validate_only)
   {
+    assert (nvs.size () == vs.size ());
+
     // The first {builds, build-{include,exclude}} override value.
     //
     const manifest_name_value* cbc (nullptr);
@@ -4950,8 +6725,19 @@ namespace bpkg
 
     // Apply overrides.
     //
-    for (const manifest_name_value& nv: nvs)
+    for (size_t vi (0); vi != nvs.size (); ++vi)
     {
+      const manifest_name_value& nv (nvs[vi]);
+      const package_manifest_overrides::value& ov (vs[vi]);
+
+      // Throw the saved exception if the value failed to parse.
+      //
+      auto parsed = [&ov] ()
+      {
+        if (ov.error != nullptr)
+          rethrow_exception (ov.error);
+      };
+
       auto bad_name = [&name, &nv] (const string& d)
       {
         throw !name.empty ()
@@ -5242,7 +7028,7 @@ namespace bpkg
         return r;
       };
 
-      // Parse the [*-]build-auxiliary[-*] value override. If the mode is not
+      // Apply the [*-]build-auxiliary[-*] value override. If the mode is not
       // validate-only, then override the matching value and throw
       // manifest_parsing if no match. But throw only unless this is a
       // configuration-specific override (build_config is not NULL) for a
@@ -5250,15 +7036,12 @@ namespace bpkg
       //
       auto override_build_auxiliary =
         [&bad_name,
-         &name,
          &config_created,
          validate_only] (const name_value& nv,
-                         string&& en,
+                         const build_auxiliary& a,
                          vector<build_auxiliary>& r,
                          build_package_config* build_config = nullptr)
       {
-        build_auxiliary a (bpkg::parse_build_auxiliary (nv, move (en), name));
-
         if (!validate_only)
         {
           auto i (find_if (r.begin (), r.end (),
@@ -5269,12 +7052,12 @@ namespace bpkg
 
           if (i != r.end ())
           {
-            *i = move (a);
+            *i = a;
           }
           else
           {
             if (build_config != nullptr && config_created (*build_config))
-              r.emplace_back (move (a));
+              r.push_back (a);
             else
               bad_name ("no match for '" + nv.name + "' value override");
           }
@@ -5283,128 +7066,143 @@ namespace bpkg
 
       const string& n (nv.name);
 
-      if (n == "builds")
+      switch (ov.kind)
       {
-        reset_builds ();
-
-        m.builds.push_back (
-          parse_build_class_expr (nv, m.builds.empty (), name));
-      }
-      else if (n == "build-include")
-      {
-        reset_build_constraints ();
+      case package_value::builds:
+        {
+          reset_builds ();
 
-        m.build_constraints.push_back (
-          parse_build_constraint (nv, false /* exclusion */, name));
-      }
-      else if (n == "build-exclude")
-      {
-        reset_build_constraints ();
+          parsed ();
+          m.builds.push_back (*ov.builds);
+          break;
+        }
+      case package_value::build_include:
+      case package_value::build_exclude:
+        {
+          reset_build_constraints ();
 
-        m.build_constraints.push_back (
-          parse_build_constraint (nv, true /* exclusion */, name));
-      }
-      else if (n == "build-bot")
-      {
-        reset_build_bots ();
+          parsed ();
+          m.build_constraints.push_back (*ov.constraint);
+          break;
+        }
+      case package_value::build_bot:
+        {
+          reset_build_bots ();
 
-        parse_build_bot (nv, name, m.build_bot_keys);
-      }
-      else if ((n.size () > 13 &&
-                n.compare (n.size () - 13, 13, "-build-config") == 0))
-      {
-        build_package_config& bc (
-          build_conf (n.size () - 13, true /* create */));
+          parse_build_bot (nv, name, m.build_bot_keys);
+          break;
+        }
+      case package_value::config_build_config:
+        {
+          build_package_config& bc (
+            build_conf (n.size () - 13, true /* create */));
 
-        auto vc (parser::split_comment (nv.value));
+          auto vc (parser::split_comment (nv.value));
 
-        bc.arguments = move (vc.first);
-        bc.comment = move (vc.second);
-      }
-      else if (n.size () > 7 && n.compare (n.size () - 7, 7, "-builds") == 0)
-      {
-        build_package_config& bc (build_conf_constr (n.size () - 7));
+          bc.arguments = move (vc.first);
+          bc.comment = move (vc.second);
+          break;
+        }
+      case package_value::config_builds:
+        {
+          build_package_config& bc (build_conf_constr (n.size () - 7));
 
-        bc.builds.push_back (
-          parse_build_class_expr (nv, bc.builds.empty (), name));
-      }
-      else if (n.size () > 14 &&
-               n.compare (n.size () - 14, 14, "-build-include") == 0)
-      {
-        build_package_config& bc (build_conf_constr (n.size () - 14));
+          parsed ();
+          bc.builds.push_back (*ov.builds);
+          break;
+        }
+      case package_value::config_build_include:
+      case package_value::config_build_exclude:
+        {
+          build_package_config& bc (build_conf_constr (n.size () - 14));
 
-        bc.constraints.push_back (
-          parse_build_constraint (nv, false /* exclusion */, name));
-      }
-      else if (n.size () > 14 &&
-               n.compare (n.size () - 14, 14, "-build-exclude") == 0)
-      {
-        build_package_config& bc (build_conf_constr (n.size () - 14));
+          parsed ();
+          bc.constraints.push_back (*ov.constraint);
+          break;
+        }
+      case package_value::config_build_bot:
+        {
+          build_package_config& bc (build_conf_bot (n.size () - 10));
+          parse_build_bot (nv, name, bc.bot_keys);
+          break;
+        }
+      case package_value::build_email:
+        {
+          reset_build_emails ();
 
-        bc.constraints.push_back (
-          parse_build_constraint (nv, true /* exclusion */, name));
-      }
-      else if (n.size () > 10 &&
-               n.compare (n.size () - 10, 10, "-build-bot") == 0)
-      {
-        build_package_config& bc (build_conf_bot (n.size () - 10));
-        parse_build_bot (nv, name, bc.bot_keys);
-      }
-      else if (n == "build-email")
-      {
-        reset_build_emails ();
-        m.build_email = parse_email (nv, "build", name, true /* empty */);
-      }
-      else if (n == "build-warning-email")
-      {
-        reset_build_emails ();
-        m.build_warning_email = parse_email (nv, "build warning", name);
-      }
-      else if (n == "build-error-email")
-      {
-        reset_build_emails ();
-        m.build_error_email = parse_email (nv, "build error", name);
-      }
-      else if (n.size () > 12 &&
-               n.compare (n.size () - 12, 12, "-build-email") == 0)
-      {
-        build_package_config& bc (build_conf_email (n.size () - 12));
+          parsed ();
+          m.build_email = *ov.email;
+          break;
+        }
+      case package_value::build_warning_email:
+        {
+          reset_build_emails ();
 
-        bc.email = parse_email (
-          nv, "build configuration", name, true /* empty */);
-      }
-      else if (n.size () > 20 &&
-               n.compare (n.size () - 20, 20, "-build-warning-email") == 0)
-      {
-        build_package_config& bc (build_conf_email (n.size () - 20));
+          parsed ();
+          m.build_warning_email = *ov.email;
+          break;
+        }
+      case package_value::build_error_email:
+        {
+          reset_build_emails ();
 
-        bc.warning_email = parse_email (
-          nv, "build configuration warning", name);
-      }
-      else if (n.size () > 18 &&
-               n.compare (n.size () - 18, 18, "-build-error-email") == 0)
-      {
-        build_package_config& bc (build_conf_email (n.size () - 18));
+          parsed ();
+          m.build_error_email = *ov.email;
+          break;
+        }
+      case package_value::config_build_email:
+        {
+          build_package_config& bc (build_conf_email (n.size () - 12));
 
-        bc.error_email = parse_email (nv, "build configuration error", name);
-      }
-      else if (optional<pair<string, string>> ba =
-               build_auxiliary::parse_value_name (n))
-      {
-        if (ba->first.empty ()) // build-auxiliary*?
+          parsed ();
+          bc.email = *ov.email;
+          break;
+        }
+      case package_value::config_build_warning_email:
         {
-          override_build_auxiliary (nv, move (ba->second), m.build_auxiliaries);
+          build_package_config& bc (build_conf_email (n.size () - 20));
+
+          parsed ();
+          bc.warning_email = *ov.email;
+          break;
         }
-        else                    // *-build-auxiliary*
+      case package_value::config_build_error_email:
         {
-          build_package_config& bc (
-            build_conf (ba->first.size (), validate_only));
+          build_package_config& bc (build_conf_email (n.size () - 18));
+
+          parsed ();
+          bc.error_email = *ov.email;
+          break;
+        }
+      case package_value::build_auxiliary:
+        {
+          if (ov.config_size == 0) // build-auxiliary*?
+          {
+            parsed ();
+            override_build_auxiliary (nv, *ov.auxiliary, m.build_auxiliaries);
+          }
+          else                     // *-build-auxiliary*
+          {
+            build_package_config& bc (
+              build_conf (ov.config_size, validate_only));
+
+            parsed ();
+            override_build_auxiliary (nv, *ov.auxiliary, bc.auxiliaries, &bc);
+          }
+
+          break;
+        }
+      default:
+        {
+          // Can only be a value which can't be overridden (see
+          // parse_overrides() for details).
+          //
+          parsed ();
 
-          override_build_auxiliary (nv, move (ba->second), bc.auxiliaries, &bc);
+          assert (false);
+          bad_name ("cannot override '" + n + "' value");
         }
       }
-      else
-        bad_name ("cannot override '" + n + "' value");
     }
 
     // Common build constraints and build config overrides are mutually
@@ -5479,7 +7277,22 @@ namespace bpkg
   void package_manifest::
   override (const vector<manifest_name_value>& nvs, const string& name)
   {
-    bpkg::override (nvs, name, *this, false /* validate_only */);
+    manifest_parsing_stats::entry* st (
+      parsing_stats != nullptr ? &parsing_stats->overrides : nullptr);
+
+    if (st != nullptr)
+    {
+      for (const manifest_name_value& nv: nvs)
+        st->bytes += nv.name.size () + nv.value.size ();
+    }
+
+    stats_timer t (st);
+
+    bpkg::override (nvs,
+                    parse_overrides (nvs, name),
+                    name,
+                    *this,
+                    false /* validate_only */);
   }
 
   void package_manifest::
@@ -5487,78 +7300,162 @@ namespace bpkg
                       const string& name)
   {
     package_manifest p;
-    bpkg::override (nvs, name, p, true /* validate_only */);
+    bpkg::override (nvs,
+                    parse_overrides (nvs, name),
+                    name,
+                    p,
+                    true /* validate_only */);
+  }
+
+  // package_manifest_overrides
+  //
+  package_manifest_overrides::
+  package_manifest_overrides (vector<manifest_name_value> nvs, string name)
+      : values_ (move (nvs)),
+        source_name_ (move (name)),
+        parsed_ (parse_overrides (values_, source_name_))
+  {
+    package_manifest p;
+    bpkg::override (values_,
+                    parsed_,
+                    source_name_,
+                    p,
+                    true /* validate_only */);
+  }
+
+  void package_manifest_overrides::
+  apply (package_manifest& m) const
+  {
+    bpkg::override (values_,
+                    parsed_,
+                    source_name_,
+                    m,
+                    false /* validate_only */);
   }
 
+  package_manifest_overrides::
+  package_manifest_overrides (package_manifest_overrides&&) = default;
+
+  package_manifest_overrides::
+  package_manifest_overrides (const package_manifest_overrides&) = default;
+
+  package_manifest_overrides& package_manifest_overrides::
+  operator= (package_manifest_overrides&&) = default;
+
+  package_manifest_overrides& package_manifest_overrides::
+  operator= (const package_manifest_overrides&) = default;
+
+  package_manifest_overrides::
+  ~package_manifest_overrides () = default;
+
   static const string description_file         ("description-file");
   static const string package_description_file ("package-description-file");
   static const string changes_file             ("changes-file");
   static const string build_file               ("build-file");
 
-  void package_manifest::
-  load_files (const function<load_function>& loader, bool iu)
+  // Make the text type explicit and return true if the text needs to be
+  // loaded from a file.
+  //
+  static bool
+  prepare_text_file (typed_text_file& text,
+                     const string& file_value_name,
+                     bool iu)
   {
-    // If required, load a file and verify that its content is not empty, if
-    // the loader returns the content. Make the text type explicit.
+    optional<text_type> t;
+
+    // Convert the potential invalid_argument exception to the
+    // manifest_parsing exception similar to what we do in the manifest
+    // parser.
     //
-    auto load = [iu, &loader] (typed_text_file& text,
-                               const string& file_value_name)
+    try
     {
-      // Make the type explicit.
-      //
-      optional<text_type> t;
-
-      // Convert the potential invalid_argument exception to the
-      // manifest_parsing exception similar to what we do in the manifest
-      // parser.
-      //
-      try
+      t = text.effective_type (iu);
+    }
+    catch (const invalid_argument& e)
+    {
+      if (text.type)
       {
-        t = text.effective_type (iu);
+        // Strip trailing "-file".
+        //
+        string prefix (file_value_name, 0, file_value_name.size () - 5);
+
+        throw parsing ("invalid " + prefix + "-type package manifest " +
+                       "value: " + e.what ());
       }
-      catch (const invalid_argument& e)
+      else
       {
-        if (text.type)
-        {
-          // Strip trailing "-file".
-          //
-          string prefix (file_value_name, 0, file_value_name.size () - 5);
-
-          throw parsing ("invalid " + prefix + "-type package manifest " +
-                         "value: " + e.what ());
-        }
-        else
-        {
-          throw parsing ("invalid " + file_value_name + " package " +
-                         "manifest value: " + e.what ());
-        }
+        throw parsing ("invalid " + file_value_name + " package " +
+                       "manifest value: " + e.what ());
       }
+    }
 
+    assert (t || iu); // Can only be absent if we ignore unknown.
 
-      assert (t || iu); // Can only be absent if we ignore unknown.
+    if (!text.type && t)
+      text.type = to_string (*t);
 
-      if (!text.type && t)
-        text.type = to_string (*t);
+    // At this point the type can only be absent if the text comes from a
+    // file. Otherwise, we would end up with the plain text.
+    //
+    assert (text.type || text.file);
 
-      // At this point the type can only be absent if the text comes from a
-      // file. Otherwise, we would end up with the plain text.
-      //
-      assert (text.type || text.file);
+    if (text.file)
+    {
+      if (!text.type)
+        text.type = "text/unknown; extension=" + text.path.extension ();
 
-      if (text.file)
-      {
-        if (!text.type)
-          text.type = "text/unknown; extension=" + text.path.extension ();
+      return true;
+    }
 
-        if (optional<string> fc = loader (file_value_name, text.path))
-        {
-          if (fc->empty ())
-            throw parsing ("package manifest value " + file_value_name +
-                           " references empty file");
+    return false;
+  }
 
-          text = typed_text_file (move (*fc), move (text.type));
-        }
-      }
+  // Replace the text file reference with the file contents, if loaded, and
+  // verify that the contents is not empty.
+  //
+  static void
+  apply_text_file (typed_text_file& text,
+                   const string& file_value_name,
+                   optional<string>&& fc)
+  {
+    if (fc)
+    {
+      if (fc->empty ())
+        throw parsing ("package manifest value " + file_value_name +
+                       " references empty file");
+
+      text = typed_text_file (move (*fc), move (text.type));
+    }
+  }
+
+  // Return the build-file value file path relative to the package root
+  // directory.
+  //
+  static path
+  buildfile_file (const path& p, bool alt_naming)
+  {
+    path r (dir_path (alt_naming ? "build2" : "build") / p);
+    r += alt_naming ? ".build2" : ".build";
+    return r;
+  }
+
+  void package_manifest::
+  load_files (const function<load_function>& loader, bool iu)
+  {
+    stats_timer t (parsing_stats != nullptr
+                   ? &parsing_stats->file_loads
+                   : nullptr);
+
+    // If required, load a file and verify that its content is not empty, if
+    // the loader returns the content. Make the text type explicit.
+    //
+    auto load = [iu, &loader] (typed_text_file& text,
+                               const string& file_value_name)
+    {
+      if (prepare_text_file (text, file_value_name, iu))
+        apply_text_file (text,
+                         file_value_name,
+                         loader (file_value_name, text.path));
     };
 
     // Load the descriptions and changes, if present.
@@ -5580,15 +7477,12 @@ namespace bpkg
       //
       assert (alt_naming);
 
-      dir_path d (*alt_naming ? "build2" : "build");
-
       for (auto i (buildfile_paths.begin ()); i != buildfile_paths.end (); )
       {
         path& p (*i);
-        path f (d / p);
-        f += *alt_naming ? ".build2" : ".build";
 
-        if (optional<string> fc = loader (build_file, f))
+        if (optional<string> fc =
+            loader (build_file, buildfile_file (p, *alt_naming)))
         {
           buildfiles.emplace_back (move (p), move (*fc));
           i = buildfile_paths.erase (i); // Moved to buildfiles.
@@ -5599,98 +7493,315 @@ namespace bpkg
     }
   }
 
-  static void
-  serialize_package_manifest (
-    manifest_serializer& s,
-    const package_manifest& m,
-    bool header_only,
-    const optional<standard_version>& /* min_ver */ = nullopt)
+  void package_manifest::
+  load_files (const function<batch_load_function>& loader, bool iu)
   {
-    // @@ Should we check that all non-optional values are specified ?
-    // @@ Should we check that values are valid: version release is not empty,
-    //    sha256sum is a proper string, ...?
-    // @@ Currently we don't know if we are serializing the individual package
-    //    manifest or the package list manifest, so can't ensure all values
-    //    allowed in the current context (*-file values).
+    stats_timer t (parsing_stats != nullptr
+                   ? &parsing_stats->file_loads
+                   : nullptr);
+
+    // Collect the files to load, making the text types explicit.
     //
+    vector<pair<string, path>> fs;
+    vector<typed_text_file*> ts;
 
-    s.next ("", "1"); // Start of manifest.
+    auto add = [iu, &fs, &ts] (typed_text_file& text,
+                               const string& file_value_name)
+    {
+      if (prepare_text_file (text, file_value_name, iu))
+      {
+        fs.emplace_back (file_value_name, text.path);
+        ts.push_back (&text);
+      }
+    };
 
-    auto bad_value ([&s](const string& d) {
-        throw serialization (s.name (), d);});
+    if (description)
+      add (*description, description_file);
 
-    if (m.name.empty ())
-      bad_value ("empty package name");
+    if (package_description)
+      add (*package_description, package_description_file);
 
-    s.next ("name", m.name.string ());
-    s.next ("version", m.version.string ());
+    for (typed_text_file& c: changes)
+      add (c, changes_file);
 
-    if (m.upstream_version)
-      s.next ("upstream-version", *m.upstream_version);
+    if (!buildfile_paths.empty ())
+    {
+      // Must already be set if the build-file value is parsed.
+      //
+      assert (alt_naming);
 
-    if (m.type)
-      s.next ("type", *m.type);
+      for (const path& p: buildfile_paths)
+        fs.emplace_back (build_file, buildfile_file (p, *alt_naming));
+    }
 
-    for (const language& l: m.languages)
-      s.next ("language", !l.impl ? l.name : l.name + "=impl");
+    if (fs.empty ())
+      return;
 
-    if (m.project)
-      s.next ("project", m.project->string ());
+    vector<optional<string>> fcs (loader (fs));
+    size_t n (ts.size ());
 
-    if (m.priority)
+    assert (fcs.size () == fs.size ());
+
+    // Apply the loaded files contents.
+    //
+    for (size_t i (0); i != n; ++i)
+      apply_text_file (*ts[i], fs[i].first, move (fcs[i]));
+
+    if (!buildfile_paths.empty ())
     {
-      size_t v (*m.priority);
-      assert (v < priority_names.size ());
+      vector<path> ps;
 
-      s.next ("priority",
-              serializer::merge_comment (priority_names[v],
-                                         m.priority->comment));
+      for (size_t i (0); i != buildfile_paths.size (); ++i)
+      {
+        path& p (buildfile_paths[i]);
+
+        if (optional<string>& fc = fcs[n + i])
+          buildfiles.emplace_back (move (p), move (*fc));
+        else
+          ps.push_back (move (p));
+      }
+
+      buildfile_paths = move (ps);
     }
+  }
 
-    s.next ("summary", m.summary);
+  // allowed_builds
+  //
+  // Return true if the name matches the wildcard pattern. Note that most
+  // patterns are plain names, so let's optimize for this case.
+  //
+  static inline bool
+  match_pattern (const string& name, const string& pattern)
+  {
+    return pattern.find_first_of ("*?[") == string::npos
+           ? name == pattern
+           : path_match (name, pattern);
+  }
 
-    for (const auto& la: m.license_alternatives)
-      s.next ("license",
-              serializer::merge_comment (concatenate (la), la.comment));
+  vector<pair<size_t, size_t>>
+  allowed_builds (const package_manifest& pm,
+                  const vector<build_target_config>& tcs,
+                  const build_class_inheritance_map& im)
+  {
+    using build_class_exprs = small_vector<build_class_expr, 1>;
 
-    if (!header_only)
-    {
-      if (!m.topics.empty ())
-        s.next ("topics", concatenate (m.topics));
+    size_t tn (tcs.size ());
 
-      if (!m.keywords.empty ())
-        s.next ("keywords", concatenate (m.keywords, " "));
+    // Assign ids to the target configuration classes and their bases and
+    // calculate the target configuration class sets.
+    //
+    strings cs;
+    for (const build_target_config& tc: tcs)
+      cs.insert (cs.end (), tc.classes.begin (), tc.classes.end ());
 
-      auto serialize_text_file = [&s] (const text_file& v, const string& n)
-      {
-        if (v.file)
-          s.next (n + "-file",
-                  serializer::merge_comment (v.path.string (), v.comment));
-        else
-          s.next (n, v.text);
-      };
+    build_class_universe u (cs, im);
 
-      auto serialize_description = [&s, &serialize_text_file]
-                                   (const optional<typed_text_file>& desc,
-                                    const char* prefix)
-      {
-        if (desc)
-        {
-          string p (prefix);
-          serialize_text_file (*desc, p + "description");
+    vector<build_class_set> tss;
+    tss.reserve (tn);
 
-          if (desc->type)
-            s.next (p + "description-type", *desc->type);
-        }
-      };
+    for (const build_target_config& tc: tcs)
+      tss.push_back (u.classes (tc.classes));
 
-      serialize_description (m.description, "" /* prefix */);
-      serialize_description (m.package_description, "package-");
+    // Per-target configuration match results for the distinct expression
+    // and constraint lists.
+    //
+    vector<pair<const build_class_exprs*, vector<bool>>> bms;
+    vector<pair<const vector<build_constraint>*, vector<bool>>> cms;
 
-      for (const auto& c: m.changes)
-        serialize_text_file (c, "changes");
+    auto match_builds = [&u, &tss, tn] (const build_class_exprs& es)
+    {
+      static const strings default_ucs ({"default"});
 
-      // If there are any changes, then serialize the type of the first
+      const strings& ucs (
+        !es.empty () && !es.front ().underlying_classes.empty ()
+        ? es.front ().underlying_classes
+        : default_ucs);
+
+      compiled_build_class_expr ue (build_class_expr (ucs, '+', ""), u);
+      compiled_build_class_expr re (build_class_expr (ucs, '&', ""), u);
+
+      vector<compiled_build_class_expr> ces;
+      ces.reserve (es.size ());
+
+      for (const build_class_expr& e: es)
+        ces.emplace_back (e, u);
+
+      vector<bool> r (tn);
+
+      for (size_t i (0); i != tn; ++i)
+      {
+        const build_class_set& ts (tss[i]);
+
+        bool m (false);
+        ue.match (ts, m);
+
+        for (const compiled_build_class_expr& e: ces)
+          e.match (ts, m);
+
+        re.match (ts, m);
+        r[i] = m;
+      }
+
+      return r;
+    };
+
+    auto match_constraints = [&tcs, tn] (const vector<build_constraint>& bcs)
+    {
+      vector<bool> r (tn, true);
+
+      if (!bcs.empty ())
+      {
+        for (size_t i (0); i != tn; ++i)
+        {
+          const build_target_config& tc (tcs[i]);
+
+          for (const build_constraint& c: bcs)
+          {
+            if (match_pattern (tc.name, c.config) &&
+                (!c.target || match_pattern (tc.target, *c.target)))
+            {
+              r[i] = !c.exclusion;
+              break;
+            }
+          }
+        }
+      }
+
+      return r;
+    };
+
+    // Find the match results for the list, calculating them if not yet
+    // done.
+    //
+    auto find = [] (auto& ms, const auto& l, const auto& match)
+      -> const vector<bool>&
+    {
+      for (const auto& m: ms)
+      {
+        if (m.first == &l)
+          return m.second;
+      }
+
+      ms.emplace_back (&l, match (l));
+      return ms.back ().second;
+    };
+
+    vector<pair<size_t, size_t>> r;
+
+    for (size_t i (0); i != pm.build_configs.size (); ++i)
+    {
+      const build_package_config& pc (pm.build_configs[i]);
+
+      const vector<bool>& bm (
+        find (bms, pc.effective_builds (pm.builds), match_builds));
+
+      const vector<bool>& cm (
+        find (cms,
+              pc.effective_constraints (pm.build_constraints),
+              match_constraints));
+
+      for (size_t j (0); j != tn; ++j)
+      {
+        if (bm[j] && cm[j])
+          r.emplace_back (i, j);
+      }
+    }
+
+    return r;
+  }
+
+  static void
+  serialize_package_manifest (
+    manifest_serializer& s,
+    const package_manifest& m,
+    bool header_only,
+    const optional<standard_version>& /* min_ver */ = nullopt)
+  {
+    // @@ Should we check that all non-optional values are specified ?
+    // @@ Should we check that values are valid: version release is not empty,
+    //    sha256sum is a proper string, ...?
+    // @@ Currently we don't know if we are serializing the individual package
+    //    manifest or the package list manifest, so can't ensure all values
+    //    allowed in the current context (*-file values).
+    //
+
+    s.next ("", "1"); // Start of manifest.
+
+    auto bad_value ([&s](const string& d) {
+        throw serialization (s.name (), d);});
+
+    if (m.name.empty ())
+      bad_value ("empty package name");
+
+    s.next ("name", m.name.string ());
+    s.next ("version", m.version.string ());
+
+    if (m.upstream_version)
+      s.next ("upstream-version", *m.upstream_version);
+
+    if (m.type)
+      s.next ("type", *m.type);
+
+    for (const language& l: m.languages)
+      s.next ("language", !l.impl ? l.name : l.name + "=impl");
+
+    if (m.project)
+      s.next ("project", m.project->string ());
+
+    if (m.priority)
+    {
+      size_t v (*m.priority);
+      assert (v < priority_names.size ());
+
+      s.next ("priority",
+              serializer::merge_comment (priority_names[v],
+                                         m.priority->comment));
+    }
+
+    s.next ("summary", m.summary);
+
+    for (const auto& la: m.license_alternatives)
+      s.next ("license",
+              serializer::merge_comment (concatenate (la), la.comment));
+
+    if (!header_only)
+    {
+      if (!m.topics.empty ())
+        s.next ("topics", concatenate (m.topics));
+
+      if (!m.keywords.empty ())
+        s.next ("keywords", concatenate (m.keywords, " "));
+
+      auto serialize_text_file = [&s] (const text_file& v, const string& n)
+      {
+        if (v.file)
+          s.next (n + "-file",
+                  serializer::merge_comment (v.path.string (), v.comment));
+        else
+          s.next (n, v.text);
+      };
+
+      auto serialize_description = [&s, &serialize_text_file]
+                                   (const optional<typed_text_file>& desc,
+                                    const char* prefix)
+      {
+        if (desc)
+        {
+          string p (prefix);
+          serialize_text_file (*desc, p + "description");
+
+          if (desc->type)
+            s.next (p + "description-type", *desc->type);
+        }
+      };
+
+      serialize_description (m.description, "" /* prefix */);
+      serialize_description (m.package_description, "package-");
+
+      for (const auto& c: m.changes)
+        serialize_text_file (c, "changes");
+
+      // If there are any changes, then serialize the type of the first
       // changes entry, if present. Note that if it is present, then we assume
       // that the type was specified explicitly and so it is the same for all
       // entries.
@@ -6029,11 +8140,184 @@ namespace bpkg
     serialize_directory_manifest (s, m);
   }
 
-  // pkg_package_manifests
+  // Call f(i) for each i in the [0, n) range using up to the specified
+  // number of threads (0 means the hardware concurrency), including the
+  // calling thread. The function is expected not to throw.
   //
-  pkg_package_manifests::
-  pkg_package_manifests (parser& p, bool iu)
+  // If the statistics is collected in the calling thread, then collect it in
+  // each worker thread into a separate object and merge these objects into
+  // the caller's statistics after all the threads are joined.
+  //
+  template <typename F>
+  static void
+  parallel_for (size_t n, size_t jobs, const F& f)
+  {
+    if (jobs == 0)
+    {
+      jobs = thread::hardware_concurrency ();
+
+      if (jobs == 0)
+        jobs = 1;
+    }
+
+    if (jobs > n)
+      jobs = n;
+
+    atomic<size_t> next (0);
+
+    auto work = [n, &next, &f] ()
+    {
+      for (size_t i; (i = next.fetch_add (1)) < n; )
+        f (i);
+    };
+
+    manifest_parsing_stats* st (parsing_stats);
+    vector<manifest_parsing_stats> sts (st != nullptr && jobs != 0
+                                        ? jobs - 1
+                                        : 0);
+
+    vector<thread> ts;
+    ts.reserve (jobs != 0 ? jobs - 1 : 0);
+
+    try
+    {
+      for (size_t i (1); i < jobs; ++i)
+      {
+        manifest_parsing_stats* s (st != nullptr ? &sts[i - 1] : nullptr);
+
+        ts.emplace_back ([s, &work] ()
+                         {
+                           if (s != nullptr)
+                           {
+                             manifest_parsing_stats_guard g (*s);
+                             work ();
+                           }
+                           else
+                             work ();
+                         });
+      }
+    }
+    catch (const system_error&)
+    {
+      // Proceed with the threads we have managed to start.
+    }
+
+    work ();
+
+    for (thread& t: ts)
+      t.join ();
+
+    if (st != nullptr)
+    {
+      for (const manifest_parsing_stats& s: sts)
+        merge (*st, s);
+    }
+  }
+
+  // Parse the package manifest represented as a list of name/value pairs
+  // that starts with the start of manifest pair and ends with the end of
+  // manifest pair, exactly as they were returned by the parser. This way the
+  // diagnostics is the same as for parsing directly from the parser.
+  //
+  template <typename O>
+  static void
+  parse_package_manifest (const string& name,
+                          vector<name_value>& vs,
+                          bool iu,
+                          const O& o,
+                          package_manifest& m)
+  {
+    assert (vs.size () >= 2);
+
+    auto i (vs.begin ());
+    auto e (vs.end ());
+
+    const name_value& nv (*i++);
+
+    if (!nv.name.empty ())
+      throw parsing (name, nv.name_line, nv.name_column,
+                     "start of package manifest expected");
+
+    if (nv.value != "1")
+      throw parsing (name, nv.value_line, nv.value_column,
+                     "unsupported format version");
+
+    // Note that the last pair (end of manifest) is returned repeatedly, if
+    // requested.
+    //
+    parse_package_manifest (name,
+                            [&i, &e] ()
+                            {
+                              return i + 1 != e ? move (*i++) : *i;
+                            },
+                            function<package_manifest::translate_function> (),
+                            iu,
+                            o,
+                            m);
+  }
+
+  // Read the package manifest name/value pairs starting from the specified
+  // start of manifest pair and up to and including the end of manifest pair.
+  //
+  static vector<name_value>
+  read_package_manifest (parser& p, name_value&& start)
+  {
+    vector<name_value> r;
+    r.push_back (move (start));
+
+    for (;;)
+    {
+      r.push_back (p.next ());
+
+      if (r.back ().empty ())
+        break;
+    }
+
+    return r;
+  }
+
+  // package_manifest::validate()
+  //
+  vector<manifest_parsing> package_manifest::
+  validate (parser& p, bool iu, bool cv, package_manifest_flags fl)
+  {
+    vector<manifest_parsing> r;
+
+    // Note that the parsing only throws for the errors that refer to the
+    // manifest as a whole (and the manifest syntax errors), saving the
+    // errors for the individual values into the list.
+    //
+    try
+    {
+      package_manifest m;
+      parse_package_manifest (p,
+                              p.next (),
+                              function<translate_function> (),
+                              iu,
+                              package_manifest_options (cv, fl, &r),
+                              m);
+
+      // Make sure this is the end.
+      //
+      name_value nv (p.next ());
+      if (!nv.empty ())
+        throw parsing (p.name (), nv.name_line, nv.name_column,
+                       "single package manifest expected");
+    }
+    catch (const manifest_parsing& e)
+    {
+      r.push_back (e);
+    }
+
+    return r;
+  }
+
+  // Parse the package list manifest and return its sha256sum.
+  //
+  static string
+  parse_package_list_manifest (parser& p, bool iu)
   {
+    string r;
     name_value nv (p.next ());
 
     auto bad_name ([&p, &nv](const string& d) {
@@ -6059,13 +8343,13 @@ namespace bpkg
 
       if (n == "sha256sum")
       {
-        if (!sha256sum.empty ())
+        if (!r.empty ())
           bad_name ("sha256sum redefinition");
 
         if (!valid_sha256 (v))
           bad_value ("invalid sha256sum");
 
-        sha256sum = move (v);
+        r = move (v);
       }
       else if (!iu)
         bad_name ("unknown name '" + n + "' in package list manifest");
@@ -6073,33 +8357,123 @@ namespace bpkg
 
     // Verify all non-optional values were specified.
     //
-    if (sha256sum.empty ())
+    if (r.empty ())
       bad_value ("no sha256sum specified");
 
-    // Parse package manifests.
-    //
-    for (nv = p.next (); !nv.empty (); nv = p.next ())
-      push_back (pkg_package_manifest (p, move (nv), iu));
+    return r;
   }
 
-  void pkg_package_manifests::
-  serialize (serializer& s, const optional<standard_version>& min_ver) const
+  // pkg_package_manifests
+  //
+  pkg_package_manifests::
+  pkg_package_manifests (parser& p, bool iu)
+      : pkg_package_manifests (p, iu, 1 /* jobs */)
   {
-    // Serialize the package list manifest.
-    //
-    // @@ Should we check that values are valid ?
-    //
-    s.next ("", "1"); // Start of manifest.
-    s.next ("sha256sum", sha256sum);
-    s.next ("", "");  // End of manifest.
+  }
 
-    // Serialize package manifests.
+  pkg_package_manifests::
+  pkg_package_manifests (parser& p, bool iu, size_t jobs)
+      : sha256sum (parse_package_list_manifest (p, iu))
+  {
+    // Parse package manifests.
     //
-    for (const package_manifest& p: *this)
+    if (jobs == 1)
     {
-      auto bad_value = [&p, &s](const string& d)
-      {
-        throw serialization (
+      for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+        push_back (pkg_package_manifest (p, move (nv), iu));
+
+      return;
+    }
+
+    // Split the stream into the package manifest name/value lists.
+    //
+    // Note that if the manifest parser fails, then we save the exception and
+    // only throw it if all the preceding package manifests are valid.
+    //
+    vector<vector<name_value>> vss;
+    exception_ptr pe;
+
+    try
+    {
+      for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+        vss.push_back (read_package_manifest (p, move (nv)));
+    }
+    catch (...)
+    {
+      pe = current_exception ();
+    }
+
+    // Parse the package manifests in parallel, skipping those which follow
+    // an invalid one.
+    //
+    size_t n (vss.size ());
+
+    vector<package_manifest> ms (n);
+    vector<exception_ptr> es (n);
+    atomic<size_t> failed (n);
+
+    parallel_for (
+      n,
+      jobs,
+      [&p, iu, &vss, &ms, &es, &failed] (size_t i)
+      {
+        if (i > failed.load ())
+          return;
+
+        try
+        {
+          parse_package_manifest (
+            p.name (),
+            vss[i],
+            iu,
+            pkg_package_manifest_options (),
+            ms[i]);
+        }
+        catch (...)
+        {
+          es[i] = current_exception ();
+
+          size_t f (failed.load ());
+          while (i < f && !failed.compare_exchange_weak (f, i)) ;
+        }
+
+        // Release the memory early.
+        //
+        vector<name_value> ().swap (vss[i]);
+      });
+
+    size_t f (failed.load ());
+
+    if (f != n)
+      rethrow_exception (es[f]);
+
+    if (pe != nullptr)
+      rethrow_exception (pe);
+
+    reserve (n);
+
+    for (package_manifest& m: ms)
+      push_back (move (m));
+  }
+
+  void pkg_package_manifests::
+  serialize (serializer& s, const optional<standard_version>& min_ver) const
+  {
+    // Serialize the package list manifest.
+    //
+    // @@ Should we check that values are valid ?
+    //
+    s.next ("", "1"); // Start of manifest.
+    s.next ("sha256sum", sha256sum);
+    s.next ("", "");  // End of manifest.
+
+    // Serialize package manifests.
+    //
+    for (const package_manifest& p: *this)
+    {
+      auto bad_value = [&p, &s](const string& d)
+      {
+        throw serialization (
           s.name (),
           d + " for " + p.name.string () + '-' + p.version.string ());
       };
@@ -6125,19 +8499,835 @@ namespace bpkg
       for (const auto& c: p.changes)
         verify_text_file (c, "changes");
 
-      if (!p.buildfile_paths.empty ())
-        bad_value ("forbidden build-file");
+      if (!p.buildfile_paths.empty ())
+        bad_value ("forbidden build-file");
+
+      if (!p.location)
+        bad_value ("no valid location");
+
+      if (!p.sha256sum)
+        bad_value ("no valid sha256sum");
+
+      pkg_package_manifest (s, p, min_ver);
+    }
+
+    s.next ("", ""); // End of stream.
+  }
+
+  // package_index
+  //
+  package_index::
+  package_index (const vector<package_manifest>& ms)
+  {
+    entries_.reserve (ms.size ());
+
+    for (const package_manifest& m: ms)
+      entries_.push_back (&m);
+
+    stable_sort (entries_.begin (), entries_.end (),
+                 [] (const package_manifest* x, const package_manifest* y)
+                 {
+                   int r (x->name.compare (y->name));
+                   return r != 0 ? r < 0 : x->version.compare (y->version) < 0;
+                 });
+
+    for (size_t i (0); i != entries_.size (); ++i)
+    {
+      if (i == 0 || entries_[i - 1]->name != entries_[i]->name)
+        groups_.push_back (i);
+    }
+
+    groups_.push_back (entries_.size ());
+  }
+
+  package_index::range package_index::
+  find (const package_name& n) const
+  {
+    if (entries_.empty ())
+      return range {entries_.end (), entries_.end ()};
+
+    // Note that the last group position is the end position.
+    //
+    auto i (partition_point (groups_.begin (), groups_.end () - 1,
+                             [&n, this] (size_t g)
+                             {
+                               return entries_[g]->name.compare (n) < 0;
+                             }));
+
+    if (i == groups_.end () - 1 || entries_[*i]->name != n)
+      return range {entries_.end (), entries_.end ()};
+
+    return range {entries_.begin () + *i, entries_.begin () + *(i + 1)};
+  }
+
+  package_index::range package_index::
+  find (const package_name& n, const version_constraint& c) const
+  {
+    if (!c.complete ())
+      throw invalid_argument ("incomplete version constraint");
+
+    range r (find (n));
+
+    // Since the group is sorted in the version ascending order, the
+    // versions that don't satisfy the minimum endpoint form its prefix and
+    // the versions that don't satisfy the maximum endpoint form its suffix.
+    //
+    // Note that the endpoints are compared as in satisfies() (see
+    // compare_endpoint() for details).
+    //
+    if (c.min_version)
+    {
+      const version& mv (*c.min_version);
+      bool o (c.min_open);
+
+      r.b = partition_point (r.b, r.e,
+                             [&mv, o] (const package_manifest* m)
+                             {
+                               int i (compare_endpoint (m->version, mv));
+                               return o ? i <= 0 : i < 0;
+                             });
+    }
+
+    if (c.max_version)
+    {
+      const version& mv (*c.max_version);
+      bool o (c.max_open);
+
+      r.e = partition_point (r.b, r.e,
+                             [&mv, o] (const package_manifest* m)
+                             {
+                               int i (compare_endpoint (m->version, mv));
+                               return o ? i < 0 : i <= 0;
+                             });
+    }
+
+    return r;
+  }
+
+  const package_manifest* package_index::
+  find_latest (const package_name& n,
+               const optional<version_constraint>& c) const
+  {
+    range r (c ? find (n, *c) : find (n));
+    return !r.empty () ? *(r.e - 1) : nullptr;
+  }
+
+  // Build the graph edge arrays in the compressed sparse row form from the
+  // list of the node/edge pairs, removing the duplicate edges. Also build
+  // the reverse edge arrays. The kind function returns the edge kind as an
+  // integer.
+  //
+  template <typename E, typename K>
+  static void
+  build_graph_edges (size_t n,
+                     vector<pair<size_t, E>>&& es,
+                     const K& kind,
+                     vector<E>& fes, vector<size_t>& fos,
+                     vector<E>& res, vector<size_t>& ros)
+  {
+    auto less = [&kind] (const pair<size_t, E>& x, const pair<size_t, E>& y)
+    {
+      return x.first       != y.first       ? x.first < y.first             :
+             x.second.node != y.second.node ? x.second.node < y.second.node :
+             kind (x.second) < kind (y.second);
+    };
+
+    auto equal = [&kind] (const pair<size_t, E>& x, const pair<size_t, E>& y)
+    {
+      return x.first == y.first               &&
+             x.second.node == y.second.node   &&
+             kind (x.second) == kind (y.second);
+    };
+
+    auto csr = [n] (const vector<pair<size_t, E>>& es,
+                    vector<E>& r,
+                    vector<size_t>& os)
+    {
+      r.reserve (es.size ());
+      os.assign (n + 1, 0);
+
+      for (const pair<size_t, E>& e: es)
+      {
+        ++os[e.first + 1];
+        r.push_back (e.second);
+      }
+
+      for (size_t i (1); i <= n; ++i)
+        os[i] += os[i - 1];
+    };
+
+    sort (es.begin (), es.end (), less);
+    es.erase (unique (es.begin (), es.end (), equal), es.end ());
+
+    csr (es, fes, fos);
+
+    for (pair<size_t, E>& e: es)
+      swap (e.first, e.second.node);
+
+    sort (es.begin (), es.end (), less);
+
+    csr (es, res, ros);
+  }
+
+  // package_graph
+  //
+  package_graph::
+  package_graph (const vector<package_manifest>& ms)
+  {
+    // Collect and order the package names.
+    //
+    vector<const package_name*> ns;
+
+    for (const package_manifest& m: ms)
+    {
+      ns.push_back (&m.name);
+
+      for (const dependency_alternatives& das: m.dependencies)
+      {
+        for (const dependency_alternative& da: das)
+        {
+          for (const dependency& d: da)
+            ns.push_back (&d.name);
+        }
+      }
+
+      for (const test_dependency& t: m.tests)
+        ns.push_back (&t.name);
+    }
+
+    sort (ns.begin (), ns.end (),
+          [] (const package_name* x, const package_name* y)
+          {
+            return x->compare (*y) < 0;
+          });
+
+    ns.erase (unique (ns.begin (), ns.end (),
+                      [] (const package_name* x, const package_name* y)
+                      {
+                        return *x == *y;
+                      }),
+              ns.end ());
+
+    names_.reserve (ns.size ());
+    for (const package_name* n: ns)
+      names_.push_back (*n);
+
+    // Collect the edges.
+    //
+    auto node = [this] (const package_name& n)
+    {
+      optional<node_type> r (find (n));
+      assert (r);
+      return *r;
+    };
+
+    vector<pair<size_t, edge>> es;
+
+    for (const package_manifest& m: ms)
+    {
+      node_type n (node (m.name));
+
+      for (const dependency_alternatives& das: m.dependencies)
+      {
+        for (const dependency_alternative& da: das)
+        {
+          for (const dependency& d: da)
+            es.emplace_back (n, edge {node (d.name), nullopt});
+        }
+      }
+
+      for (const test_dependency& t: m.tests)
+        es.emplace_back (n, edge {node (t.name), t.type});
+    }
+
+    build_graph_edges (names_.size (),
+                       move (es),
+                       [] (const edge& e)
+                       {
+                         return e.type ? static_cast<size_t> (*e.type) + 1 : 0;
+                       },
+                       dependencies_, dependency_offsets_,
+                       dependents_, dependent_offsets_);
+  }
+
+  optional<package_graph::node_type> package_graph::
+  find (const package_name& n) const
+  {
+    auto i (lower_bound (names_.begin (), names_.end (), n,
+                         [] (const package_name& x, const package_name& y)
+                         {
+                           return x.compare (y) < 0;
+                         }));
+
+    if (i == names_.end () || *i != n)
+      return nullopt;
+
+    return static_cast<node_type> (i - names_.begin ());
+  }
+
+  package_graph::range package_graph::
+  dependencies (node_type n) const
+  {
+    return range {dependencies_.begin () + dependency_offsets_[n],
+                  dependencies_.begin () + dependency_offsets_[n + 1]};
+  }
+
+  package_graph::range package_graph::
+  dependents (node_type n) const
+  {
+    return range {dependents_.begin () + dependent_offsets_[n],
+                  dependents_.begin () + dependent_offsets_[n + 1]};
+  }
+
+  vector<package_graph::node_type> package_graph::
+  affected (const vector<node_type>& ns) const
+  {
+    vector<node_type> r;
+    vector<bool> visited (names_.size (), false);
+
+    auto visit = [&r, &visited] (node_type n)
+    {
+      if (!visited[n])
+      {
+        visited[n] = true;
+        r.push_back (n);
+      }
+    };
+
+    for (node_type n: ns)
+      visit (n);
+
+    // Note that r grows while we iterate over it.
+    //
+    for (size_t i (0); i != r.size (); ++i)
+    {
+      node_type n (r[i]);
+
+      for (const edge& e: dependents (n))
+      {
+        if (!e.type)
+          visit (e.node);
+      }
+
+      for (const edge& e: dependencies (n))
+      {
+        if (e.type)
+          visit (e.node);
+      }
+    }
+
+    return r;
+  }
+
+  // lazy_package_manifest
+  //
+  const uint32_t lazy_package_manifest::restored_value;
+
+  lazy_package_manifest::
+  lazy_package_manifest (const string& name, vector<name_value>&& vs, bool iu)
+      : lazy_package_manifest (make_shared<const string> (name), move (vs), iu)
+  {
+  }
+
+  lazy_package_manifest::
+  lazy_package_manifest (shared_ptr<const string> sn,
+                         vector<name_value>&& vs,
+                         bool iu,
+                         manifest_arena* a)
+      : name_ (move (sn)),
+        ignore_unknown_ (iu),
+        text_ (arena_allocator<char> (a)),
+        values_ (arena_allocator<value> (a))
+  {
+    assert (vs.size () >= 2);
+
+    const string& name (*name_);
+
+    // Note that in contrast to the complete parsing, we don't fail for the
+    // unknown values here, leaving that to manifest().
+    //
+    const name_value* nv (&vs.front ());
+
+    auto bad_name ([&name, &nv](const string& d) {
+        throw parsing (name, nv->name_line, nv->name_column, d);});
+
+    auto bad_value ([&name, &nv](const string& d) {
+        throw parsing (name, nv->value_line, nv->value_column, d);});
+
+    // Make sure this is the start and we support the version.
+    //
+    if (!nv->name.empty ())
+      bad_name ("start of package manifest expected");
+
+    if (nv->value != "1")
+      bad_value ("unsupported format version");
+
+    // Pack the values, skipping the header values text.
+    //
+    size_t n (0);
+    for (const name_value& v: vs)
+      n += v.name.size () + v.value.size ();
+
+    text_.reserve (n);
+    values_.reserve (vs.size ());
+
+    auto pack = [this] (const name_value& v, bool header)
+    {
+      text_.append (v.name.data (), v.name.size ());
+
+      if (!header)
+        text_.append (v.value.data (), v.value.size ());
+
+      values_.push_back (
+        value {v.name_line,
+               v.value_line,
+               static_cast<uint32_t> (v.name_column),
+               static_cast<uint32_t> (v.value_column),
+               static_cast<uint32_t> (v.name.size ()),
+               (header
+                ? restored_value
+                : static_cast<uint32_t> (v.value.size ()))});
+    };
+
+    pack (*nv, false /* header */);
+
+    for (++nv; !nv->empty (); ++nv)
+    {
+      const string& n (nv->name);
+      bool header (true);
+
+      if (n == "name")
+      {
+        if (!this->name.empty ())
+          bad_name ("package name redefinition");
+
+        this->name = parse_package_name (name_value (*nv), name);
+      }
+      else if (n == "version")
+      {
+        if (!version.empty ())
+          bad_name ("package version redefinition");
+
+        version = parse_package_version (*nv, name);
+      }
+      else if (n == "location")
+      {
+        if (!location.empty ())
+          bad_name ("package location redefinition");
+
+        location = parse_package_location (name_value (*nv), name);
+      }
+      else if (n == "sha256sum")
+      {
+        if (sha256sum)
+          bad_name ("package sha256sum redefinition");
+
+        sha256sum = parse_package_sha256sum (name_value (*nv), name);
+      }
+      else
+        header = false;
+
+      pack (*nv, header);
+    }
+
+    pack (*nv, false /* header */); // End of manifest.
+
+    // Verify all non-optional values were specified.
+    //
+    if (this->name.empty ())
+      bad_value ("no package name specified");
+    else if (version.empty ())
+      bad_value ("no package version specified");
+
+    if (location.empty ())
+      bad_name ("no package location specified");
+  }
+
+  lazy_package_manifest::
+  lazy_package_manifest (lazy_package_manifest&&) = default;
+
+  lazy_package_manifest::
+  lazy_package_manifest (const lazy_package_manifest&) = default;
+
+  lazy_package_manifest& lazy_package_manifest::
+  operator= (lazy_package_manifest&&) = default;
+
+  lazy_package_manifest& lazy_package_manifest::
+  operator= (const lazy_package_manifest&) = default;
+
+  lazy_package_manifest::
+  ~lazy_package_manifest () = default;
+
+  const package_manifest& lazy_package_manifest::
+  manifest () const
+  {
+    if (manifest_ == nullptr)
+    {
+      if (error_ != nullptr)
+        rethrow_exception (error_);
+
+      try
+      {
+        // Unpack the name/value list, restoring the header values from the
+        // parsed data members. Note that these values have already been
+        // validated and so their string representations parse into the
+        // same values.
+        //
+        vector<name_value> vs;
+        vs.reserve (values_.size ());
+
+        const char* t (text_.data ());
+
+        for (const value& v: values_)
+        {
+          name_value nv;
+          nv.name.assign (t, v.name_size);
+          t += v.name_size;
+
+          if (v.value_size != restored_value)
+          {
+            nv.value.assign (t, v.value_size);
+            t += v.value_size;
+          }
+          else
+          {
+            const string& n (nv.name);
+
+            if (n == "name")
+              nv.value = name.string ();
+            else if (n == "version")
+              nv.value = version.string ();
+            else if (n == "location")
+              nv.value = location.posix_string ();
+            else
+            {
+              assert (n == "sha256sum" && sha256sum);
+              nv.value = *sha256sum;
+            }
+          }
+
+          nv.name_line = v.name_line;
+          nv.name_column = v.name_column;
+          nv.value_line = v.value_line;
+          nv.value_column = v.value_column;
+
+          vs.push_back (move (nv));
+        }
+
+        package_manifest m;
+        parse_package_manifest (*name_,
+                                vs,
+                                ignore_unknown_,
+                                pkg_package_manifest_options (),
+                                m);
+
+        manifest_ = make_shared_package_manifest (move (m));
+      }
+      catch (...)
+      {
+        error_ = current_exception ();
+      }
+
+      // Note that the packed values can't be reused on failure either,
+      // since the same exception is rethrown.
+      //
+      text_type (text_.get_allocator ()).swap (text_);
+      values_type (values_.get_allocator ()).swap (values_);
+
+      if (error_ != nullptr)
+        rethrow_exception (error_);
+    }
+
+    return *manifest_;
+  }
+
+  // lazy_pkg_package_manifests
+  //
+  lazy_pkg_package_manifests::
+  lazy_pkg_package_manifests (parser& p, bool iu)
+      : sha256sum (parse_package_list_manifest (p, iu))
+  {
+    // Share the name between all the manifests.
+    //
+    shared_ptr<const string> n (make_shared<const string> (p.name ()));
+
+    for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+      emplace_back (n, read_package_manifest (p, move (nv)), iu);
+  }
+
+  lazy_pkg_package_manifests::
+  lazy_pkg_package_manifests (parser& p, manifest_arena& a, bool iu)
+      : sha256sum (parse_package_list_manifest (p, iu))
+  {
+    shared_ptr<const string> n (make_shared<const string> (p.name ()));
+
+    for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+      emplace_back (n, read_package_manifest (p, move (nv)), iu, &a);
+  }
+
+  // pkg_package_manifest_reader
+  //
+  pkg_package_manifest_reader::
+  pkg_package_manifest_reader (parser& p, bool iu)
+      : sha256sum (parse_package_list_manifest (p, iu)),
+        parser_ (p),
+        ignore_unknown_ (iu)
+  {
+  }
+
+  optional<package_manifest> pkg_package_manifest_reader::
+  next ()
+  {
+    if (end_)
+      return nullopt;
+
+    name_value nv (parser_.next ());
+
+    if (nv.empty ())
+    {
+      end_ = true;
+      return nullopt;
+    }
+
+    return pkg_package_manifest (parser_, move (nv), ignore_unknown_);
+  }
+
+  // pkg_package_manifests_snapshot
+  //
+  // Calculate the checksum of the package manifest name/value list.
+  //
+  static string
+  package_manifest_checksum (const vector<name_value>& nvs)
+  {
+    sha256 cs;
+
+    // Note that the names and values are zero-terminated, so that, for
+    // example, the `a: bc` and `ab: c` pairs produce different checksums.
+    //
+    for (const name_value& nv: nvs)
+    {
+      cs.append (nv.name.c_str (), nv.name.size () + 1);
+      cs.append (nv.value.c_str (), nv.value.size () + 1);
+    }
+
+    return cs.string ();
+  }
+
+  // Extract the package name and version from the package manifest
+  // name/value list. Return false if any of them is absent, redefined, or
+  // invalid, in which case the manifest is expected to fail the complete
+  // parsing.
+  //
+  static bool
+  package_manifest_key (const vector<name_value>& nvs,
+                        package_name& n,
+                        version& v)
+  {
+    const string* nm (nullptr);
+    const string* vr (nullptr);
+
+    for (const name_value& nv: nvs)
+    {
+      const string** r (nv.name == "name"    ? &nm :
+                        nv.name == "version" ? &vr :
+                        nullptr);
+
+      if (r == nullptr)
+        continue;
+
+      if (*r != nullptr)
+        return false;
+
+      *r = &nv.value;
+    }
+
+    if (nm == nullptr || vr == nullptr)
+      return false;
+
+    try
+    {
+      n = package_name (*nm);
+      v = version (*vr);
+    }
+    catch (const invalid_argument&)
+    {
+      return false;
+    }
+
+    return !(v.release && v.release->empty ());
+  }
+
+  // Parse the pkg package manifest list element name/value list.
+  //
+  static package_manifest
+  parse_pkg_package_manifest (const string& name,
+                              vector<name_value>& nvs,
+                              bool iu)
+  {
+    package_manifest r;
+    parse_package_manifest (name,
+                            nvs,
+                            iu,
+                            pkg_package_manifest_options (),
+                            r);
+    return r;
+  }
+
+  pkg_package_manifests_snapshot::
+  pkg_package_manifests_snapshot (parser& p, bool iu)
+      : sha256sum (parse_package_list_manifest (p, iu))
+  {
+    for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+    {
+      vector<name_value> nvs (read_package_manifest (p, move (nv)));
+
+      package_snapshot s;
+      s.checksum = package_manifest_checksum (nvs);
+
+      // Fallback to the complete parsing to issue the diagnostics.
+      //
+      if (!package_manifest_key (nvs, s.name, s.version))
+      {
+        package_manifest m (parse_pkg_package_manifest (p.name (), nvs, iu));
+        s.name = move (m.name);
+        s.version = move (m.version);
+      }
+
+      push_back (move (s));
+    }
+  }
+
+  // diff_pkg_package_manifests()
+  //
+  pkg_package_manifests_diff
+  diff_pkg_package_manifests (const pkg_package_manifests_snapshot& old,
+                              parser& p,
+                              bool iu)
+  {
+    pkg_package_manifests_diff r;
+    pkg_package_manifests_snapshot& ns (r.snapshot);
+
+    ns.sha256sum = parse_package_list_manifest (p, iu);
+
+    // Index the old revision packages by name and version.
+    //
+    auto compare = [&old] (size_t i, const package_name& n, const version& v)
+    {
+      const package_snapshot& s (old[i]);
+      int r (s.name.compare (n));
+      return r != 0 ? r : s.version.compare (v);
+    };
+
+    vector<size_t> ix;
+    ix.reserve (old.size ());
+
+    for (size_t i (0); i != old.size (); ++i)
+      ix.push_back (i);
+
+    sort (ix.begin (), ix.end (),
+          [&old, &compare] (size_t x, size_t y)
+          {
+            return compare (x, old[y].name, old[y].version) < 0;
+          });
+
+    auto find = [&ix, &compare] (const package_name& n, const version& v)
+    {
+      auto i (partition_point (ix.begin (), ix.end (),
+                               [&n, &v, &compare] (size_t i)
+                               {
+                                 return compare (i, n, v) < 0;
+                               }));
+
+      return i != ix.end () && compare (*i, n, v) == 0 ? *i : string::npos;
+    };
+
+    vector<bool> present (old.size (), false);
+
+    for (name_value nv (p.next ()); !nv.empty (); nv = p.next ())
+    {
+      vector<name_value> nvs (read_package_manifest (p, move (nv)));
+
+      package_snapshot s;
+      s.checksum = package_manifest_checksum (nvs);
+
+      // Skip the complete parsing if the package is unchanged.
+      //
+      if (package_manifest_key (nvs, s.name, s.version))
+      {
+        size_t i (find (s.name, s.version));
+
+        if (i != string::npos && old[i].checksum == s.checksum)
+        {
+          present[i] = true;
+          ns.push_back (move (s));
+          continue;
+        }
+      }
+
+      package_manifest m (parse_pkg_package_manifest (p.name (), nvs, iu));
+
+      s.name = m.name;
+      s.version = m.version;
+
+      size_t i (find (s.name, s.version));
+
+      if (i != string::npos)
+      {
+        present[i] = true;
+        r.changed.push_back (move (m));
+      }
+      else
+        r.added.push_back (move (m));
+
+      ns.push_back (move (s));
+    }
+
+    for (size_t i (0); i != old.size (); ++i)
+    {
+      if (!present[i])
+        r.removed.emplace_back (old[i].name, old[i].version);
+    }
+
+    return r;
+  }
+
+  // dir_package_manifest_reader
+  //
+  dir_package_manifest_reader::
+  dir_package_manifest_reader (parser& p, bool iu)
+      : parser_ (p), ignore_unknown_ (iu), next_ (p.next ())
+  {
+  }
+
+  optional<package_manifest> dir_package_manifest_reader::
+  next ()
+  {
+    if (next_.empty ())
+      return nullopt;
+
+    package_manifest r (
+      dir_package_manifest (parser_, move (next_), ignore_unknown_));
 
-      if (!p.location)
-        bad_value ("no valid location");
+    // Note that we need to read the start of the next manifest before we can
+    // report the duplicate (see below).
+    //
+    next_ = parser_.next ();
 
-      if (!p.sha256sum)
-        bad_value ("no valid sha256sum");
+    // Normally, such manifests are created manually, so let's check for
+    // duplicates.
+    //
+    const path& l (*r.location);
 
-      pkg_package_manifest (s, p, min_ver);
+    for (const path& pl: locations_)
+    {
+      if (pl == l)
+        throw parsing (parser_.name (),
+                       next_.name_line, next_.name_column,
+                       "duplicate package manifest");
     }
 
-    s.next ("", ""); // End of stream.
+    locations_.push_back (l);
+    return r;
   }
 
   // Parse package directory manifests.
@@ -6145,24 +9335,10 @@ namespace bpkg
   static void
   parse_directory_manifests (parser& p, bool iu, vector<package_manifest>& ms)
   {
-    // Normally, such manifests are created manually, so let's check for
-    // duplicates.
-    //
-    for (name_value nv (p.next ()); !nv.empty (); )
-    {
-      package_manifest pm (dir_package_manifest (p, move (nv), iu));
-      nv = p.next ();
-
-      for (const auto& m: ms)
-      {
-        if (m.location == pm.location)
-          throw parsing (p.name (),
-                         nv.name_line, nv.name_column,
-                         "duplicate package manifest");
-      }
+    dir_package_manifest_reader r (p, iu);
 
-      ms.push_back (move (pm));
-    }
+    while (optional<package_manifest> m = r.next ())
+      ms.push_back (move (*m));
   }
 
   // Serialize package directory manifests.
@@ -6954,6 +10130,8 @@ namespace bpkg
       canonical_name_ += '#';
       canonical_name_ += *url_.fragment;
     }
+
+    canonical_name_hash_ = hash<std::string> () (canonical_name_);
   }
 
   string repository_location::
@@ -6985,6 +10163,39 @@ namespace bpkg
     return r;
   }
 
+  // repository_location_cache
+  //
+  const repository_location& repository_location_cache::
+  intern (const std::string& s, const optional<repository_type>& t, bool l)
+  {
+    unordered_map<std::string, const repository_location*>& ps (
+      parsed_[t ? 2 + static_cast<size_t> (*t) : l ? 1 : 0]);
+
+    auto i (ps.find (s));
+    if (i == ps.end ())
+      i = ps.emplace (s, &intern (repository_location (s, t, l))).first;
+
+    return *i->second;
+  }
+
+  const repository_location& repository_location_cache::
+  intern (const repository_location& l)
+  {
+    if (!l.empty () && l.relative ())
+      throw invalid_argument ("relative repository location");
+
+    return *locations_.insert (l).first;
+  }
+
+  const repository_location& repository_location_cache::
+  intern (repository_location&& l)
+  {
+    if (!l.empty () && l.relative ())
+      throw invalid_argument ("relative repository location");
+
+    return *locations_.insert (move (l)).first;
+  }
+
   // git_ref_filter
   //
   git_ref_filter::
@@ -7054,6 +10265,172 @@ namespace bpkg
     return r;
   }
 
+  // git_ref_filter_matcher
+  //
+  git_ref_filter_matcher::
+  git_ref_filter_matcher (const git_ref_filters& fs)
+  {
+    // The last filter for each commit id.
+    //
+    unordered_map<string, filter> cs;
+
+    for (size_t i (0); i != fs.size (); ++i)
+    {
+      const git_ref_filter& rf (fs[i]);
+      filter f {i, rf.exclusion};
+
+      if (rf.default_refs ())
+      {
+        default_refs_ = f;
+        continue;
+      }
+
+      if (!rf.name)
+      {
+        cs[*rf.commit] = f;
+        continue;
+      }
+
+      const string& n (*rf.name);
+
+      // Candidate reference names in the lookup order.
+      //
+      small_vector<string, 3> ns;
+
+      if (n.compare (0, 5, "refs/") == 0)
+        ns.push_back (n);
+      else
+      {
+        ns.push_back ("refs/" + n);
+        ns.push_back ("refs/tags/" + n);
+        ns.push_back ("refs/heads/" + n);
+      }
+
+      if (path_pattern (n))
+      {
+        patterns_.emplace_back (f, move (ns));
+      }
+      else
+      {
+        size_t j (names_.size ());
+        names_.push_back (f);
+
+        for (size_t p (0); p != ns.size (); ++p)
+          candidates_[move (ns[p])].push_back (name_candidate {j, p});
+      }
+
+      if (n.size () <= 40 &&
+          find_if_not (n.begin (), n.end (),
+                       static_cast<bool (*)(char)> (xdigit)) == n.end ())
+        abbreviated_.emplace_back (f, n);
+    }
+
+    commits_.reserve (cs.size ());
+
+    for (auto& c: cs)
+      commits_.emplace_back (c.second, c.first);
+
+    sort (commits_.begin (), commits_.end (),
+          [] (const pair<filter, string>& x, const pair<filter, string>& y)
+          {
+            return x.first.index < y.first.index;
+          });
+
+    for (size_t i (0); i != commits_.size (); ++i)
+      commit_indexes_.emplace (commits_[i].second, i);
+  }
+
+  git_ref_filter_matcher::result git_ref_filter_matcher::
+  match (const vector<git_ref>& rs) const
+  {
+    size_t n (rs.size ());
+
+    // The last matching filter for each reference, if any.
+    //
+    vector<const filter*> ms (n, nullptr);
+
+    auto update = [&ms] (size_t i, const filter& f)
+    {
+      if (ms[i] == nullptr || ms[i]->index < f.index)
+        ms[i] = &f;
+    };
+
+    // The first advertised candidate position and the reference index for
+    // each refname.
+    //
+    vector<pair<size_t, size_t>> ns (names_.size (),
+                                     make_pair (string::npos, size_t (0)));
+
+    vector<bool> advertised (commits_.size (), false);
+
+    for (size_t i (0); i != n; ++i)
+    {
+      const git_ref& r (rs[i]);
+
+      auto j (candidates_.find (r.name));
+      if (j != candidates_.end ())
+      {
+        for (const name_candidate& c: j->second)
+        {
+          pair<size_t, size_t>& p (ns[c.name]);
+
+          if (c.position < p.first)
+            p = make_pair (c.position, i);
+        }
+      }
+
+      for (const auto& p: patterns_)
+      {
+        for (const string& pt: p.second)
+        {
+          if (path_match (r.name, pt))
+          {
+            update (i, p.first);
+            break;
+          }
+        }
+      }
+
+      for (const auto& a: abbreviated_)
+      {
+        if (r.commit.compare (0, a.second.size (), a.second) == 0)
+          update (i, a.first);
+      }
+
+      auto k (commit_indexes_.find (r.commit));
+      if (k != commit_indexes_.end ())
+      {
+        update (i, commits_[k->second].first);
+        advertised[k->second] = true;
+      }
+
+      if (default_refs_                              &&
+          r.name.compare (0, 11, "refs/tags/v") == 0 &&
+          parse_standard_version (string (r.name, 11)))
+        update (i, *default_refs_);
+    }
+
+    for (size_t i (0); i != ns.size (); ++i)
+    {
+      if (ns[i].first != string::npos)
+        update (ns[i].second, names_[i]);
+    }
+
+    result r;
+    r.refs.reserve (n);
+
+    for (const filter* f: ms)
+      r.refs.push_back (f != nullptr && !f->exclusion);
+
+    for (size_t i (0); i != commits_.size (); ++i)
+    {
+      if (!advertised[i] && !commits_[i].first.exclusion)
+        r.commits.push_back (commits_[i].second);
+    }
+
+    return r;
+  }
+
   // repository_manifest
   //
   optional<string> repository_manifest::
@@ -7142,6 +10519,13 @@ namespace bpkg
                              bool iu,
                              bool verify_version = true)
   {
+    manifest_parsing_stats::entry* mst (
+      parsing_stats != nullptr
+      ? &parsing_stats->repository_manifests
+      : nullptr);
+
+    stats_timer mt (mst);
+
     auto bad_name ([&p, &nv](const string& d) {
         throw parsing (p.name (), nv.name_line, nv.name_column, d);});
 
@@ -7175,6 +10559,14 @@ namespace bpkg
       string& n (nv.name);
       string& v (nv.value);
 
+      if (mst != nullptr)
+        mst->bytes += n.size () + v.size ();
+
+      stats_timer vt (mst != nullptr
+                      ? &parsing_stats->repository_values[n]
+                      : nullptr,
+                      n.size () + v.size ());
+
       if (n == "location")
       {
         if (location)
@@ -7467,6 +10859,149 @@ namespace bpkg
     return empty_base;
   }
 
+  // repository_graph
+  //
+  repository_graph::
+  repository_graph (const vector<repository>& rs)
+  {
+    // Intern the repository locations and collect the edges, using the
+    // interned location addresses as the temporary node ids.
+    //
+    struct location_edge
+    {
+      const repository_location* from;
+      const repository_location* to;
+      repository_role role;
+    };
+
+    vector<location_edge> les;
+
+    for (const repository& r: rs)
+    {
+      const repository_location& rl (r.location);
+
+      if (rl.empty () || rl.relative ())
+        throw invalid_argument ("repository location '" + rl.string () +
+                                "' is empty or relative");
+
+      const repository_location* l (&cache_.intern (rl));
+      locations_.push_back (l);
+
+      assert (r.manifests != nullptr);
+
+      for (const repository_manifest& m: *r.manifests)
+      {
+        repository_role rr (m.effective_role ());
+
+        if (rr == repository_role::base)
+          continue;
+
+        if (m.location.empty ())
+          throw invalid_argument (
+            string (rr == repository_role::prerequisite
+                    ? "empty prerequisite"
+                    : "empty complement") +
+            " repository location in '" + rl.string () + '\'');
+
+        const repository_location* d (
+          &cache_.intern (m.location.relative ()
+                          ? repository_location (m.location, rl)
+                          : m.location));
+
+        les.push_back (location_edge {l, d, rr});
+        locations_.push_back (d);
+      }
+    }
+
+    // Order the nodes by the canonical name. Note that the locations with
+    // the same canonical name are interned as a single object.
+    //
+    sort (locations_.begin (), locations_.end (),
+          [] (const repository_location* x, const repository_location* y)
+          {
+            return x->canonical_name () < y->canonical_name ();
+          });
+
+    locations_.erase (unique (locations_.begin (), locations_.end ()),
+                      locations_.end ());
+
+    auto node = [this] (const repository_location* l)
+    {
+      optional<node_type> r (find (l->canonical_name ()));
+      assert (r);
+      return *r;
+    };
+
+    vector<pair<size_t, edge>> nes;
+    nes.reserve (les.size ());
+
+    for (const location_edge& e: les)
+      nes.emplace_back (node (e.from), edge {node (e.to), e.role});
+
+    build_graph_edges (locations_.size (),
+                       move (nes),
+                       [] (const edge& e)
+                       {
+                         return static_cast<size_t> (e.role);
+                       },
+                       dependencies_, dependency_offsets_,
+                       dependents_, dependent_offsets_);
+  }
+
+  optional<repository_graph::node_type> repository_graph::
+  find (const std::string& n) const
+  {
+    auto i (lower_bound (locations_.begin (), locations_.end (), n,
+                         [] (const repository_location* x, const string& y)
+                         {
+                           return x->canonical_name () < y;
+                         }));
+
+    if (i == locations_.end () || (*i)->canonical_name () != n)
+      return nullopt;
+
+    return static_cast<node_type> (i - locations_.begin ());
+  }
+
+  repository_graph::range repository_graph::
+  dependencies (node_type n) const
+  {
+    return range {dependencies_.begin () + dependency_offsets_[n],
+                  dependencies_.begin () + dependency_offsets_[n + 1]};
+  }
+
+  repository_graph::range repository_graph::
+  dependents (node_type n) const
+  {
+    return range {dependents_.begin () + dependent_offsets_[n],
+                  dependents_.begin () + dependent_offsets_[n + 1]};
+  }
+
+  vector<repository_graph::node_type> repository_graph::
+  reachable (node_type n, bool prerequisites) const
+  {
+    vector<node_type> r ({n});
+    vector<bool> visited (locations_.size (), false);
+    visited[n] = true;
+
+    // Note that r grows while we iterate over it.
+    //
+    for (size_t i (0); i != r.size (); ++i)
+    {
+      for (const edge& e: dependencies (r[i]))
+      {
+        if (!visited[e.node] &&
+            (prerequisites || e.role == repository_role::complement))
+        {
+          visited[e.node] = true;
+          r.push_back (e.node);
+        }
+      }
+    }
+
+    return r;
+  }
+
   // pkg_repository_manifest
   //
   repository_manifest
@@ -7722,6 +11257,92 @@ namespace bpkg
     serialize_repository_manifests (s, header, *this);
   }
 
+  // parse_*_repository_manifests()
+  //
+  template <typename M>
+  static vector<M>
+  parse_repository_manifest_lists (
+    const vector<repository_manifests_text>& ts,
+    bool iu,
+    size_t jobs,
+    vector<exception_ptr>* errors)
+  {
+    size_t n (ts.size ());
+
+    vector<M> r (n);
+    vector<exception_ptr> es (n);
+    atomic<size_t> failed (n);
+
+    // Unless all the lists need to be parsed, skip those which follow an
+    // invalid one.
+    //
+    parallel_for (
+      n,
+      jobs,
+      [&ts, iu, errors, &r, &es, &failed] (size_t i)
+      {
+        if (errors == nullptr && i > failed.load ())
+          return;
+
+        try
+        {
+          const repository_manifests_text& t (ts[i]);
+          r[i] = parse_manifest<M> (t.data, t.size, t.name, iu);
+        }
+        catch (...)
+        {
+          es[i] = current_exception ();
+
+          size_t f (failed.load ());
+          while (i < f && !failed.compare_exchange_weak (f, i)) ;
+        }
+      });
+
+    if (errors != nullptr)
+    {
+      *errors = move (es);
+    }
+    else
+    {
+      size_t f (failed.load ());
+
+      if (f != n)
+        rethrow_exception (es[f]);
+    }
+
+    return r;
+  }
+
+  vector<pkg_repository_manifests>
+  parse_pkg_repository_manifests (const vector<repository_manifests_text>& ts,
+                                  bool iu,
+                                  size_t jobs,
+                                  vector<exception_ptr>* errors)
+  {
+    return parse_repository_manifest_lists<pkg_repository_manifests> (
+      ts, iu, jobs, errors);
+  }
+
+  vector<dir_repository_manifests>
+  parse_dir_repository_manifests (const vector<repository_manifests_text>& ts,
+                                  bool iu,
+                                  size_t jobs,
+                                  vector<exception_ptr>* errors)
+  {
+    return parse_repository_manifest_lists<dir_repository_manifests> (
+      ts, iu, jobs, errors);
+  }
+
+  vector<git_repository_manifests>
+  parse_git_repository_manifests (const vector<repository_manifests_text>& ts,
+                                  bool iu,
+                                  size_t jobs,
+                                  vector<exception_ptr>* errors)
+  {
+    return parse_repository_manifest_lists<git_repository_manifests> (
+      ts, iu, jobs, errors);
+  }
+
   // signature_manifest
   //
   signature_manifest::
@@ -7838,6 +11459,18 @@ namespace bpkg
     return package_name (string (s, n));
   }
 
+  // Verify that the version is not the earliest or stub version.
+  //
+  static void
+  verify_package_version (const version& v)
+  {
+    if (v.release && v.release->empty ())
+      throw invalid_argument ("earliest version");
+
+    if (v.compare (stub_version, true /* ignore_revision */) == 0)
+      throw invalid_argument ("stub version");
+  }
+
   version
   extract_package_version (const char* s, version::flags fl)
   {
@@ -7846,16 +11479,74 @@ namespace bpkg
     if (const char* p = traits::find (s, traits::length (s), '/'))
     {
       version r (p + 1, fl);
+      verify_package_version (r);
+      return r;
+    }
 
-      if (r.release && r.release->empty ())
-        throw invalid_argument ("earliest version");
+    return version ();
+  }
 
-      if (r.compare (stub_version, true /* ignore_revision */) == 0)
-        throw invalid_argument ("stub version");
+  size_t
+  split_package_name_version (const char* s, size_t n) noexcept
+  {
+    auto digit = [] (char c) {return c >= '0' && c <= '9';};
 
-      return r;
+    // Note that the name can't be empty and so we start from the second
+    // character.
+    //
+    for (size_t i (1); i + 1 < n; ++i)
+    {
+      if (s[i] == '-')
+      {
+        char c (s[i + 1]);
+
+        if (digit (c) || (c == '+' && i + 2 < n && digit (s[i + 2])))
+          return i;
+      }
     }
 
-    return version ();
+    return 0;
+  }
+
+  // Split the package archive or directory name throwing invalid_argument
+  // if the version component is not found.
+  //
+  static size_t
+  split_package_name_version_or_throw (const char* s, size_t n)
+  {
+    size_t r (split_package_name_version (s, n));
+
+    if (r == 0)
+      throw invalid_argument ("no package version");
+
+    return r;
+  }
+
+  pair<package_name, version>
+  extract_package_name_version (const char* s, size_t n, version::flags fl)
+  {
+    size_t nn (split_package_name_version_or_throw (s, n));
+
+    version v (string (s + nn + 1, n - nn - 1), fl);
+    verify_package_version (v);
+
+    return make_pair (package_name (string (s, nn)), move (v));
+  }
+
+  pair<package_name, version_handle>
+  extract_package_name_version (const char* s,
+                                size_t n,
+                                version_pool& vp,
+                                version::flags fl)
+  {
+    size_t nn (split_package_name_version_or_throw (s, n));
+
+    // Note that the version strings normally fit into the small string
+    // buffer and so constructing the lookup key doesn't allocate memory.
+    //
+    version_handle v (vp.intern (string (s + nn + 1, n - nn - 1), fl));
+    verify_package_version (*v);
+
+    return make_pair (package_name (string (s, nn)), v);
   }
 }
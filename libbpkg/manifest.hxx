@@ -5,21 +5,28 @@
 #define LIBBPKG_MANIFEST_HXX
 
 #include <map>
+#include <memory>     // shared_ptr, make_shared()
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cstddef>    // size_t
 #include <cstdint>    // uint*_t
 #include <ostream>
 #include <utility>    // move(), pair
+#include <exception>  // exception_ptr
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <libbutl/url.hxx>
 #include <libbutl/path.hxx>
 #include <libbutl/optional.hxx>
 #include <libbutl/small-vector.hxx>
 #include <libbutl/standard-version.hxx>
+#include <libbutl/manifest-types.hxx>   // manifest_name_value
 #include <libbutl/manifest-forward.hxx>
 
+#include <libbpkg/arena.hxx>
 #include <libbpkg/package-name.hxx>
 
 #include <libbpkg/export.hxx>
@@ -29,6 +36,8 @@ namespace bpkg
 {
   using strings = std::vector<std::string>;
 
+  class version_key;
+
   // @@ Let's create <libbpkg/types.hxx> with "basic" package types.
   //
   class LIBBPKG_EXPORT version
@@ -125,6 +134,13 @@ namespace bpkg
              bool ignore_revision = false,
              bool ignore_iteration = false) const noexcept;
 
+    // Return the binary sort key for this version (see version_key for
+    // details).
+    //
+    version_key
+    compare_key (bool ignore_revision = false,
+                 bool ignore_iteration = false) const;
+
     bool
     empty () const noexcept
     {
@@ -179,6 +195,369 @@ namespace bpkg
   version::flags operator&= (version::flags&, version::flags);
   version::flags operator|= (version::flags&, version::flags);
 
+  // Binary version sort key.
+  //
+  // The key is a byte sequence which, being compared as such (memcmp()),
+  // gives the same result as version::compare() called for the respective
+  // versions with the same ignore_revision and ignore_iteration arguments as
+  // the ones the keys were created with (see version::compare_key()). Note
+  // that keys created with different ignore_* arguments are not comparable.
+  //
+  // Normally, the key is created once per version and is then used for
+  // sorting, binary searching, and hashing large version sets.
+  //
+  // The key is the concatenation of the following parts:
+  //
+  // <epoch>              2 bytes, big-endian
+  // <canonical-upstream> terminated with the zero byte
+  // <canonical-release>  terminated with the zero byte
+  // <revision>           3 bytes, presence flag and big-endian value
+  // <iteration>          4 bytes, big-endian
+  //
+  // The revision and iteration parts are omitted if ignored.
+  //
+  class version_key
+  {
+  public:
+    version_key () = default;
+
+    explicit
+    version_key (std::string k): data_ (std::move (k)) {}
+
+    int
+    compare (const version_key&) const noexcept;
+
+    std::size_t
+    hash () const noexcept {return std::hash<std::string> () (data_);}
+
+    const std::string&
+    data () const noexcept {return data_;}
+
+  private:
+    std::string data_;
+  };
+
+  inline bool
+  operator< (const version_key& x, const version_key& y) noexcept
+  {
+    return x.compare (y) < 0;
+  }
+
+  inline bool
+  operator> (const version_key& x, const version_key& y) noexcept
+  {
+    return x.compare (y) > 0;
+  }
+
+  inline bool
+  operator== (const version_key& x, const version_key& y) noexcept
+  {
+    return x.data () == y.data ();
+  }
+
+  inline bool
+  operator<= (const version_key& x, const version_key& y) noexcept
+  {
+    return x.compare (y) <= 0;
+  }
+
+  inline bool
+  operator>= (const version_key& x, const version_key& y) noexcept
+  {
+    return x.compare (y) >= 0;
+  }
+
+  inline bool
+  operator!= (const version_key& x, const version_key& y) noexcept
+  {
+    return !(x == y);
+  }
+
+  // Compact version representation.
+  //
+  // All the version parts, including the canonical ones, are stored in a
+  // single heap-allocated block, so a version takes a pointer plus the block
+  // with the part lengths and characters (the special empty version takes no
+  // block at all). Normally it is used for keeping large version sets in
+  // memory with the full-fledged version object only created as needed.
+  //
+  // Note that comparing compact versions doesn't allocate and gives the same
+  // result as for the respective version objects.
+  //
+  class LIBBPKG_EXPORT compact_version
+  {
+  public:
+    // Create the special empty version.
+    //
+    compact_version () = default;
+
+    explicit
+    compact_version (const version&);
+
+    // Throw std::invalid_argument if the passed string is not a valid version
+    // representation.
+    //
+    explicit
+    compact_version (const std::string& v,
+                     version::flags fl = version::fold_zero_revision)
+        : compact_version (version (v, fl)) {}
+
+    explicit
+    operator version () const;
+
+    std::uint16_t
+    epoch () const noexcept;
+
+    std::string
+    upstream () const;
+
+    butl::optional<std::string>
+    release () const;
+
+    butl::optional<std::uint16_t>
+    revision () const noexcept;
+
+    std::uint32_t
+    iteration () const noexcept;
+
+    std::string
+    canonical_upstream () const;
+
+    std::string
+    canonical_release () const;
+
+    bool
+    empty () const noexcept {return data_ == nullptr;}
+
+    // See the version class for the semantics of the ignore_* arguments.
+    //
+    std::string
+    string (bool ignore_revision = false, bool ignore_iteration = false) const;
+
+    int
+    compare (const compact_version&,
+             bool ignore_revision = false,
+             bool ignore_iteration = false) const noexcept;
+
+    // Return the number of bytes allocated for the version parts.
+    //
+    std::size_t
+    capacity () const noexcept;
+
+    compact_version (compact_version&& v) noexcept: data_ (v.data_)
+    {
+      v.data_ = nullptr;
+    }
+
+    compact_version (const compact_version&);
+    compact_version& operator= (compact_version&&) noexcept;
+    compact_version& operator= (const compact_version&);
+
+    ~compact_version () {delete[] data_;}
+
+  private:
+    // Block layout:
+    //
+    // <epoch>            2 bytes
+    // <flags>            1 byte, release (0x01) and revision (0x02) presence
+    // <revision>         2 bytes
+    // <iteration>        4 bytes
+    // <lengths>          4 x 4 bytes, upstream, release, and canonical parts
+    // <characters>       upstream, release, and canonical parts
+    //
+    // Note that all the multi-byte values are stored in the native byte
+    // order and are accessed via memcpy() since they are not aligned.
+    //
+    char* data_ = nullptr;
+  };
+
+  inline std::ostream&
+  operator<< (std::ostream& os, const compact_version& v)
+  {
+    return os << (v.empty () ? "<empty-version>" : v.string ());
+  }
+
+  inline bool
+  operator< (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) < 0;
+  }
+
+  inline bool
+  operator> (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) > 0;
+  }
+
+  inline bool
+  operator== (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) == 0;
+  }
+
+  inline bool
+  operator<= (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) <= 0;
+  }
+
+  inline bool
+  operator>= (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) >= 0;
+  }
+
+  inline bool
+  operator!= (const compact_version& x, const compact_version& y) noexcept
+  {
+    return x.compare (y) != 0;
+  }
+
+  // Handle to a version stored in the version pool (see below).
+  //
+  // Note that handles referring to the same version object (and thus
+  // obtained from the same pool for the same version representation)
+  // compare equal without comparing the versions themselves.
+  //
+  class version_handle
+  {
+  public:
+    // Create the null handle.
+    //
+    version_handle () = default;
+
+    const version&
+    operator* () const noexcept {return *version_;}
+
+    const version*
+    operator-> () const noexcept {return version_;}
+
+    const version*
+    get () const noexcept {return version_;}
+
+    explicit
+    operator bool () const noexcept {return version_ != nullptr;}
+
+    // Note that the handles must not be null.
+    //
+    int
+    compare (const version_handle& h,
+             bool ignore_revision = false,
+             bool ignore_iteration = false) const noexcept
+    {
+      return version_ == h.version_
+             ? 0
+             : version_->compare (*h.version_,
+                                  ignore_revision,
+                                  ignore_iteration);
+    }
+
+  private:
+    friend class version_pool;
+
+    explicit
+    version_handle (const version* v): version_ (v) {}
+
+    const version* version_ = nullptr;
+  };
+
+  inline bool
+  operator< (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) < 0;
+  }
+
+  inline bool
+  operator> (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) > 0;
+  }
+
+  inline bool
+  operator== (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) == 0;
+  }
+
+  inline bool
+  operator<= (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) <= 0;
+  }
+
+  inline bool
+  operator>= (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) >= 0;
+  }
+
+  inline bool
+  operator!= (const version_handle& x, const version_handle& y) noexcept
+  {
+    return x.compare (y) != 0;
+  }
+
+  // Version interning pool.
+  //
+  // Store each distinct version once and hand out handles to the stored
+  // versions. Versions that have the same string representation (including
+  // the revision and iteration) are stored as a single object. The version
+  // strings are also only parsed once per parsing flags combination. This
+  // way, when loading many manifests which normally refer to the same
+  // versions over and over again, the memory is saved and no identical
+  // strings are parsed repeatedly.
+  //
+  // The version objects (and thus the handles) stay valid for the lifetime
+  // of the pool. Note that the pool is not thread-safe.
+  //
+  class LIBBPKG_EXPORT version_pool
+  {
+  public:
+    // Parse the version string, unless already parsed with the same flags,
+    // and return the handle to the stored version. Throw
+    // std::invalid_argument if the passed string is not a valid version
+    // representation.
+    //
+    version_handle
+    intern (const std::string&,
+            version::flags = version::fold_zero_revision);
+
+    version_handle
+    intern (const version&);
+
+    version_handle
+    intern (version&&);
+
+    // Return the number of distinct versions stored.
+    //
+    std::size_t
+    size () const noexcept {return versions_.size ();}
+
+    bool
+    empty () const noexcept {return versions_.empty ();}
+
+    version_pool () = default;
+
+    // Note that the move constructor preserves the handles validity.
+    //
+    version_pool (version_pool&&) = default;
+    version_pool (const version_pool&) = delete;
+
+    version_pool& operator= (version_pool&&) = default;
+    version_pool& operator= (const version_pool&) = delete;
+
+  private:
+    // Versions keyed by their string representations, which are empty for
+    // the special empty version.
+    //
+    std::unordered_map<std::string, version> versions_;
+
+    // Parsed version strings keyed by the parsing flags (which can only take
+    // the values from 0 to 3).
+    //
+    std::unordered_map<std::string, const version*> parsed_[4];
+  };
+
   // priority
   //
   class priority
@@ -436,6 +815,34 @@ namespace bpkg
   inline bool
   operator!= (const version_constraint&, const version_constraint&);
 
+  // Return true if the version satisfies the version constraint. Note that
+  // an endpoint version revision is ignored if it is not specified and the
+  // iteration is always ignored (see version_constraint for details).
+  //
+  // Note also that the constraint must be complete (see
+  // version_constraint::complete() for details).
+  //
+  LIBBPKG_EXPORT bool
+  satisfies (const version&, const version_constraint&) noexcept;
+
+  // Return the constraint which is satisfied by the versions satisfying both
+  // constraints or nullopt if there are no such versions. Note that the
+  // resulting constraint endpoints are copied from the argument constraints
+  // and so the constraint is not reduced to a shortcut (`~X`, `^X`) form.
+  //
+  // Note that the constraints must be complete.
+  //
+  LIBBPKG_EXPORT butl::optional<version_constraint>
+  intersect (const version_constraint&, const version_constraint&);
+
+  // Return true if every version satisfying the second constraint also
+  // satisfies the first one.
+  //
+  // Note that the constraints must be complete.
+  //
+  LIBBPKG_EXPORT bool
+  subsumes (const version_constraint&, const version_constraint&) noexcept;
+
   struct LIBBPKG_EXPORT dependency
   {
     package_name name;
@@ -851,6 +1258,64 @@ namespace bpkg
   package_manifest_flags
   operator|= (package_manifest_flags&, package_manifest_flags);
 
+  // Manifest parsing statistics.
+  //
+  // While a manifest_parsing_stats_guard object is alive, the manifest
+  // parsing functions called in the current thread collect statistics into
+  // the specified object. These functions are the package manifest parsing
+  // (including the package manifest lists), package_manifest::override(),
+  // package_manifest::load_files(), and the repository manifest parsing.
+  // When collection is disabled, the overhead is one thread-local pointer
+  // check per manifest (or per override()/load_files() call).
+  //
+  // The package manifest values are grouped by the value name. Values that
+  // are recognized by the name suffix use the suffix prefixed with `*` as
+  // the group (*-build-config, *-build, etc), and the build auxiliary
+  // values use *build-auxiliary*. Note that the group time also includes
+  // the processing which is postponed until all the values are read
+  // (dependency parsing, text type resolution, etc).
+  //
+  // Note also that if the manifest lists are parsed using multiple jobs,
+  // then the statistics collected by the worker threads is merged into the
+  // calling thread's object once parsing is complete. In this case the
+  // times are summed across the threads and so can exceed the elapsed time.
+  //
+  struct manifest_parsing_stats
+  {
+    struct entry
+    {
+      std::uint64_t count = 0; // Number of values, manifests, or calls.
+      std::uint64_t bytes = 0; // Total size of value names and values.
+      std::uint64_t time = 0;  // Total time in nanoseconds.
+    };
+
+    std::map<std::string, entry> package_values;
+    std::map<std::string, entry> repository_values;
+
+    entry package_manifests;
+    entry repository_manifests;
+    entry overrides;            // package_manifest::override() calls.
+    entry file_loads;           // package_manifest::load_files() calls.
+  };
+
+  class LIBBPKG_EXPORT manifest_parsing_stats_guard
+  {
+  public:
+    explicit
+    manifest_parsing_stats_guard (manifest_parsing_stats&);
+
+    ~manifest_parsing_stats_guard ();
+
+    manifest_parsing_stats_guard (const manifest_parsing_stats_guard&) =
+      delete;
+
+    manifest_parsing_stats_guard&
+    operator= (const manifest_parsing_stats_guard&) = delete;
+
+  private:
+    manifest_parsing_stats* prev_;
+  };
+
   // Target build configuration class term.
   //
   class LIBBPKG_EXPORT build_class_term
@@ -980,41 +1445,146 @@ namespace bpkg
     return os << bce.string ();
   }
 
-  // Build auxiliary configuration name-matching wildcard. Includes optional
-  // environment name (specified as a suffix in the [*-]build-auxiliary[-*]
-  // value name) and comment.
+  // Set of build classes represented as a bitset indexed with the class ids
+  // (see build_class_universe for details).
   //
-  class LIBBPKG_EXPORT build_auxiliary
+  class LIBBPKG_EXPORT build_class_set
   {
   public:
-    std::string environment_name;
+    explicit
+    build_class_set (std::size_t size = 0): words_ ((size + 63) / 64) {}
 
-    // Filesystem wildcard pattern for the build auxiliary configuration name.
-    //
-    std::string config;
+    bool
+    test (std::size_t id) const
+    {
+      return (words_[id / 64] >> (id % 64) & 1) != 0;
+    }
 
-    std::string comment;
+    void
+    set (std::size_t id) {words_[id / 64] |= std::uint64_t (1) << (id % 64);}
 
-    build_auxiliary () = default;
-    build_auxiliary (std::string en,
-                     std::string cf,
-                     std::string cm)
-        : environment_name (std::move (en)),
-          config (std::move (cf)),
-          comment (std::move (cm)) {}
+    build_class_set&
+    operator|= (const build_class_set&);
 
-    // Parse a package manifest value name in the [*-]build-auxiliary[-*] form
-    // into the pair of the build package configuration name (first) and the
-    // build auxiliary environment name (second), with an unspecified name
-    // represented as an empty string. Return nullopt if the value name
-    // doesn't match this form.
-    //
-    static butl::optional<std::pair<std::string, std::string>>
-    parse_value_name (const std::string&);
+  private:
+    std::vector<std::uint64_t> words_;
   };
 
-  // Package build configuration. Includes comment and optional overrides for
-  // target build configuration class expressions/constraints, auxiliaries,
+  // Fixed set of build classes (normally, the classes of all the target
+  // build configurations together with their bases) with the classes
+  // assigned the integer ids and their base closures precomputed. Used to
+  // compile build class expressions for the repeated matching against
+  // multiple target build configurations (see compiled_build_class_expr for
+  // details).
+  //
+  class LIBBPKG_EXPORT build_class_universe
+  {
+  public:
+    // Assign ids to the specified classes as well as to all the classes
+    // mentioned in the derived-to-base map. As for build_class_expr::match(),
+    // the map is not verified but the inheritance cycles are tolerated.
+    //
+    build_class_universe (const strings& classes,
+                          const build_class_inheritance_map&);
+
+    // Return the number of classes in the universe.
+    //
+    std::size_t
+    size () const {return closures_.size ();}
+
+    // Return the class id or nullopt if the class is not in the universe.
+    //
+    butl::optional<std::size_t>
+    find (const std::string&) const;
+
+    // Return the set containing the specified classes and recursively their
+    // bases. Throw std::invalid_argument if any of the classes is not in the
+    // universe.
+    //
+    build_class_set
+    classes (const strings&) const;
+
+  private:
+    std::map<std::string, std::size_t> ids_;
+    std::vector<build_class_set> closures_; // Class and its bases.
+  };
+
+  // Build class expression compiled against a build class universe.
+  //
+  // The matching semantics is the same as for build_class_expr::match().
+  // Note, however, that the target build configuration classes are expected
+  // to be specified as a set produced by build_class_universe::classes() of
+  // the same universe. The class names which are not in the universe never
+  // match.
+  //
+  class LIBBPKG_EXPORT compiled_build_class_expr
+  {
+  public:
+    compiled_build_class_expr (const build_class_expr&,
+                               const build_class_universe&);
+
+    void
+    match (const build_class_set&, bool& result) const;
+
+    bool
+    match (const build_class_set& cs) const
+    {
+      bool r (false);
+      match (cs, r);
+      return r;
+    }
+
+  public:
+    // Expression terms in the pre-order with the nested expression terms
+    // following the parenthesized expression term.
+    //
+    struct term
+    {
+      char operation;    // '+', '-' or '&'
+      bool inverted;
+      bool simple;       // Class id if true, nested expression otherwise.
+      std::size_t value; // Class id (npos if not in the universe) or number
+                         // of the nested expression terms.
+    };
+
+    std::vector<term> terms;
+  };
+
+  // Build auxiliary configuration name-matching wildcard. Includes optional
+  // environment name (specified as a suffix in the [*-]build-auxiliary[-*]
+  // value name) and comment.
+  //
+  class LIBBPKG_EXPORT build_auxiliary
+  {
+  public:
+    std::string environment_name;
+
+    // Filesystem wildcard pattern for the build auxiliary configuration name.
+    //
+    std::string config;
+
+    std::string comment;
+
+    build_auxiliary () = default;
+    build_auxiliary (std::string en,
+                     std::string cf,
+                     std::string cm)
+        : environment_name (std::move (en)),
+          config (std::move (cf)),
+          comment (std::move (cm)) {}
+
+    // Parse a package manifest value name in the [*-]build-auxiliary[-*] form
+    // into the pair of the build package configuration name (first) and the
+    // build auxiliary environment name (second), with an unspecified name
+    // represented as an empty string. Return nullopt if the value name
+    // doesn't match this form.
+    //
+    static butl::optional<std::pair<std::string, std::string>>
+    parse_value_name (const std::string&);
+  };
+
+  // Package build configuration. Includes comment and optional overrides for
+  // target build configuration class expressions/constraints, auxiliaries,
   // custom bot public keys, and notification emails.
   //
   // Note that in the package manifest the build bot keys list contains the
@@ -1529,6 +2099,35 @@ namespace bpkg
     validate_overrides (const std::vector<butl::manifest_name_value>&,
                         const std::string& source_name);
 
+    // Validate the individual package manifest, performing the same checks
+    // as the respective constructor, and return the list of errors in the
+    // order they have been detected (empty if the manifest is valid).
+    //
+    // After an error is detected, the manifest value it refers to is
+    // skipped and the validation continues as if the value was absent. This
+    // way, all the invalid values are normally reported in a single parsing
+    // pass, unless the error refers to the manifest as a whole (missing
+    // required value, etc) or to multiple values (description and its type,
+    // etc), in which case the validation stops. Note that as a result,
+    // skipping an invalid value can produce an additional error (for
+    // example, about a missing required value).
+    //
+    // Also note that the individual values are still parsed into their
+    // respective objects, since that is how they are validated (package
+    // names, versions, URLs, etc). However, the results of the postponed
+    // dependency, requirement, and test dependency parsing are not stored,
+    // the requirement alternatives are not built from the parsed
+    // representation, and the values are not completed.
+    //
+    static std::vector<butl::manifest_parsing>
+    validate (butl::manifest_parser&,
+              bool ignore_unknown = false,
+              bool complete_values = true,
+              package_manifest_flags =
+                package_manifest_flags::forbid_location  |
+                package_manifest_flags::forbid_sha256sum |
+                package_manifest_flags::forbid_fragment);
+
     // If the minimum libbpkg version is specified, then also apply the
     // required backward compatibility workarounds to the serialized manifest
     // so that clients of all libbpkg versions greater or equal to the
@@ -1568,8 +2167,101 @@ namespace bpkg
     void
     load_files (const std::function<load_function>&,
                 bool ignore_unknown = false);
+
+    // As above but pass all the files to load to the load function at once,
+    // as a list of the manifest value name/file path pairs, so that it can
+    // load them concurrently (from a network storage, etc). The function is
+    // expected to return the list of the file contents (or nullopt for the
+    // files to leave unexpanded) in the same order. Note that the function
+    // is not called if there are no files to load.
+    //
+    using batch_load_function =
+      std::vector<butl::optional<std::string>> (
+        const std::vector<std::pair<std::string, butl::path>>& files);
+
+    void
+    load_files (const std::function<batch_load_function>&,
+                bool ignore_unknown = false);
   };
 
+  // Package manifest value overrides parsed and validated once and then
+  // applied to multiple package manifests, potentially concurrently.
+  //
+  // See package_manifest::override() for the overrides semantics.
+  //
+  class LIBBPKG_EXPORT package_manifest_overrides
+  {
+  public:
+    // Parse and validate the overrides. Throw manifest_parsing on error (see
+    // package_manifest::validate_overrides() for details).
+    //
+    package_manifest_overrides (std::vector<butl::manifest_name_value>,
+                                std::string source_name);
+
+    // Apply the overrides to the package manifest, similar to
+    // package_manifest::override(). Note that applying may still fail (no
+    // build config exists for specified *-builds, etc).
+    //
+    void
+    apply (package_manifest&) const;
+
+    package_manifest_overrides (package_manifest_overrides&&);
+    package_manifest_overrides (const package_manifest_overrides&);
+    package_manifest_overrides& operator= (package_manifest_overrides&&);
+    package_manifest_overrides& operator= (const package_manifest_overrides&);
+
+    ~package_manifest_overrides ();
+
+  public:
+    struct value; // Pre-parsed value (implementation details).
+
+  private:
+    std::vector<butl::manifest_name_value> values_;
+    std::string source_name_;
+    std::vector<value> parsed_;
+  };
+
+  // Target build configuration as seen by the package build constraints.
+  //
+  struct build_target_config
+  {
+    std::string name;   // Configuration name.
+    std::string target; // Target triplet.
+    strings classes;
+  };
+
+  // Evaluate the package build configurations against the target build
+  // configurations and return the list of the allowed (package build
+  // configuration index, target build configuration index) pairs, ordered by
+  // the package configuration index and then by the target configuration
+  // index.
+  //
+  // A target configuration is allowed for a package configuration if it
+  // matches the combined effective build class expression of the package
+  // configuration (see build_package_config::effective_builds() for
+  // details) and is not excluded by its effective build constraints (see
+  // build_package_config::effective_constraints() for details). The combined
+  // expression is formed as follows:
+  //
+  //   +<ucs> <expr>... &( +<ucs> )
+  //
+  // Where <ucs> is the underlying class set of the first expression or
+  // `default`, if not specified. The target configuration is then checked
+  // against the constraint patterns in order and the first match determines
+  // if it is excluded. If no constraint matches, then the configuration is
+  // not excluded.
+  //
+  // The class expressions are compiled and the constraint patterns are
+  // matched only once per distinct list of expressions/constraints (which
+  // are normally shared by the package configurations via the common
+  // values), rather than once per each package configuration and target
+  // configuration pair.
+  //
+  LIBBPKG_EXPORT std::vector<std::pair<std::size_t, std::size_t>>
+  allowed_builds (const package_manifest&,
+                  const std::vector<build_target_config>&,
+                  const build_class_inheritance_map&);
+
   // Create individual package manifest.
   //
   package_manifest
@@ -1637,6 +2329,18 @@ namespace bpkg
     pkg_package_manifests (butl::manifest_parser&,
                            bool ignore_unknown = false);
 
+    // As above but parse the package manifests using up to the specified
+    // number of threads (0 means the hardware concurrency). The manifest
+    // stream is first split into the per-package name/value lists in a
+    // single pass and then these lists are parsed in parallel. The resulting
+    // package manifest order as well as the diagnostics are the same as for
+    // the sequential parsing (in particular, the error for the first invalid
+    // package manifest in the list is reported).
+    //
+    pkg_package_manifests (butl::manifest_parser&,
+                           bool ignore_unknown,
+                           std::size_t jobs);
+
     // If the minimum libbpkg version is specified, then also apply the
     // required backward compatibility workarounds to the serialized package
     // manifests list (see package_manifest::serialize() for details).
@@ -1647,6 +2351,476 @@ namespace bpkg
       const butl::optional<butl::standard_version>& = butl::nullopt) const;
   };
 
+  // Package manifest list index by the package name and version.
+  //
+  // The list entries are grouped by the package name with each group sorted
+  // in the version ascending order. As a result, the package lookup as well
+  // as the lookup of the package versions satisfying a version constraint
+  // are binary searches rather than the linear list scans.
+  //
+  // Note that the index refers to the list entries which must stay valid
+  // and unmodified while the index is in use.
+  //
+  class LIBBPKG_EXPORT package_index
+  {
+  public:
+    using entries_type = std::vector<const package_manifest*>;
+    using iterator = entries_type::const_iterator;
+
+    // Subrange of the package group.
+    //
+    struct range
+    {
+      iterator b;
+      iterator e;
+
+      iterator
+      begin () const {return b;}
+
+      iterator
+      end () const {return e;}
+
+      bool
+      empty () const {return b == e;}
+
+      std::size_t
+      size () const {return static_cast<std::size_t> (e - b);}
+    };
+
+    package_index () = default;
+
+    explicit
+    package_index (const std::vector<package_manifest>&);
+
+    // Return all the package versions in the version ascending order or an
+    // empty range if the package is not present in the list.
+    //
+    range
+    find (const package_name&) const;
+
+    // Return the package versions that satisfy the version constraint.
+    // Throw std::invalid_argument if the constraint is incomplete (see
+    // version_constraint::complete() for details).
+    //
+    // Note that, as for the dependency resolution, the constraint endpoint
+    // version revision is ignored if it is not specified and the iteration
+    // is always ignored.
+    //
+    range
+    find (const package_name&, const version_constraint&) const;
+
+    // Return the latest package version, optionally satisfying the version
+    // constraint, or NULL if there is none.
+    //
+    const package_manifest*
+    find_latest (
+      const package_name&,
+      const butl::optional<version_constraint>& = butl::nullopt) const;
+
+    // Return all the list entries ordered by the package name and then by
+    // the package version.
+    //
+    const entries_type&
+    entries () const noexcept {return entries_;}
+
+    std::size_t
+    size () const noexcept {return entries_.size ();}
+
+    bool
+    empty () const noexcept {return entries_.empty ();}
+
+  private:
+    entries_type entries_;
+
+    // Positions of the package groups in entries_ plus the end position.
+    //
+    std::vector<std::size_t> groups_;
+  };
+
+  // Package dependency graph.
+  //
+  // The graph nodes are the distinct names of the packages in the package
+  // manifest list as well as of the packages they refer to. The graph edges
+  // go from the package to the packages it refers to via the depends (all
+  // the dependency alternatives) and tests, examples, and benchmarks
+  // manifest values, regardless of the package versions, dependency
+  // version constraints, enable conditions, etc. There is at most one edge
+  // of each kind between any two nodes.
+  //
+  // The graph is built in a single pass over the list and is stored in the
+  // compressed sparse row form: all the outgoing (as well as incoming) edges
+  // are stored in a single array in the node order and each node refers to
+  // its edges by the position in this array. The nodes are ordered by the
+  // package name, so the node lookup is a binary search.
+  //
+  class LIBBPKG_EXPORT package_graph
+  {
+  public:
+    using node_type = std::size_t;
+
+    struct edge
+    {
+      node_type node;
+
+      // Absent for the depends value edges.
+      //
+      butl::optional<test_dependency_type> type;
+    };
+
+    using edges_type = std::vector<edge>;
+    using iterator = edges_type::const_iterator;
+
+    struct range
+    {
+      iterator b;
+      iterator e;
+
+      iterator
+      begin () const {return b;}
+
+      iterator
+      end () const {return e;}
+
+      bool
+      empty () const {return b == e;}
+
+      std::size_t
+      size () const {return static_cast<std::size_t> (e - b);}
+    };
+
+    package_graph () = default;
+
+    explicit
+    package_graph (const std::vector<package_manifest>&);
+
+    // Return the number of nodes.
+    //
+    std::size_t
+    size () const noexcept {return names_.size ();}
+
+    bool
+    empty () const noexcept {return names_.empty ();}
+
+    // Note: the node must be less than size().
+    //
+    const package_name&
+    name (node_type n) const {return names_[n];}
+
+    butl::optional<node_type>
+    find (const package_name&) const;
+
+    // Return the packages the package refers to.
+    //
+    range
+    dependencies (node_type) const;
+
+    // Return the packages that refer to the package, with the edge kind
+    // being the same as for the corresponding dependencies() edge.
+    //
+    range
+    dependents (node_type) const;
+
+    // Return the packages affected by a change in the specified packages.
+    // That is, these packages themselves, the packages that directly or
+    // indirectly depend on them, and the tests, examples, and benchmarks
+    // packages of all of the above. The nodes are returned in the
+    // (breadth-first) traversal order, starting from the specified nodes
+    // (with duplicates removed).
+    //
+    std::vector<node_type>
+    affected (const std::vector<node_type>&) const;
+
+  private:
+    std::vector<package_name> names_;
+
+    // Node edges and their positions in the edge arrays plus the end
+    // position.
+    //
+    edges_type dependencies_;
+    std::vector<std::size_t> dependency_offsets_;
+
+    edges_type dependents_;
+    std::vector<std::size_t> dependent_offsets_;
+  };
+
+  // Shared immutable package manifest.
+  //
+  // Copying such a handle only increments the reference count rather than
+  // copying the manifest values (bootstrap-build, buildfiles, description
+  // text, etc). Since the package manifest has no mutable state, it is safe
+  // to share the manifest between threads for reading.
+  //
+  using shared_package_manifest = std::shared_ptr<const package_manifest>;
+  using shared_package_manifests = std::vector<shared_package_manifest>;
+
+  inline shared_package_manifest
+  make_shared_package_manifest (package_manifest&& m)
+  {
+    return std::make_shared<const package_manifest> (std::move (m));
+  }
+
+  // Move the package manifests from the list into the shared manifests.
+  //
+  inline shared_package_manifests
+  make_shared_package_manifests (std::vector<package_manifest>&& ms)
+  {
+    shared_package_manifests r;
+    r.reserve (ms.size ());
+
+    for (package_manifest& m: ms)
+      r.push_back (make_shared_package_manifest (std::move (m)));
+
+    ms.clear ();
+    return r;
+  }
+
+  // The pkg package manifest with the deferred parsing.
+  //
+  // Only the package name, version, location, and sha256sum values are
+  // parsed and validated on construction with the remaining values saved as
+  // is. The complete manifest is parsed on the first call to manifest()
+  // with the same validation and diagnostics as for pkg_package_manifest().
+  // Such a manifest is normally used when the package list is only scanned
+  // for the package name, version, etc (listing, searching, etc).
+  //
+  // To keep the memory footprint low, the deferred values are packed into a
+  // single buffer, without the header values which are restored from the
+  // parsed data members, and the name used for diagnostics is shared between
+  // the manifests of the same list. Also note that the manifest copies
+  // share the complete manifest, if already parsed.
+  //
+  // Note that the deferred parsing is not thread-safe.
+  //
+  class LIBBPKG_EXPORT lazy_package_manifest
+  {
+  public:
+    using version_type = bpkg::version;
+
+    package_name name;
+    version_type version;
+    butl::path location;
+    butl::optional<std::string> sha256sum;
+
+    // Parse the complete manifest, if not parsed yet, and return it. Throw
+    // manifest_parsing on error. If the parsing fails, then the same
+    // exception is thrown on the subsequent calls.
+    //
+    const package_manifest&
+    manifest () const;
+
+    // Return true if the complete manifest is already parsed.
+    //
+    bool
+    parsed () const {return manifest_ != nullptr;}
+
+  public:
+    // Parse the manifest header values from the name/value list that starts
+    // with the start of manifest pair and ends with the end of manifest pair
+    // (see package_manifest for the name argument semantics).
+    //
+    lazy_package_manifest (const std::string& name,
+                           std::vector<butl::manifest_name_value>&&,
+                           bool ignore_unknown = false);
+
+    // As above but share the name with other manifests and, if specified,
+    // allocate the deferred values from the arena (see
+    // lazy_pkg_package_manifests for details).
+    //
+    lazy_package_manifest (std::shared_ptr<const std::string> name,
+                           std::vector<butl::manifest_name_value>&&,
+                           bool ignore_unknown = false,
+                           manifest_arena* = nullptr);
+
+    lazy_package_manifest (lazy_package_manifest&&);
+    lazy_package_manifest (const lazy_package_manifest&);
+    lazy_package_manifest& operator= (lazy_package_manifest&&);
+    lazy_package_manifest& operator= (const lazy_package_manifest&);
+
+    ~lazy_package_manifest ();
+
+  private:
+    // The deferred name/value pair, including the start and end of manifest
+    // pairs. The name and value are stored in the text buffer one after
+    // another in the pairs order. The header value is not stored and its
+    // size is restored_value.
+    //
+    struct value
+    {
+      std::uint64_t name_line;
+      std::uint64_t value_line;
+      std::uint32_t name_column;
+      std::uint32_t value_column;
+      std::uint32_t name_size;
+      std::uint32_t value_size;
+    };
+
+    static const std::uint32_t restored_value = UINT32_MAX;
+
+    using text_type = std::basic_string<char,
+                                        std::char_traits<char>,
+                                        arena_allocator<char>>;
+
+    using values_type = std::vector<value, arena_allocator<value>>;
+
+    std::shared_ptr<const std::string> name_;
+    bool ignore_unknown_;
+    mutable text_type text_;
+    mutable values_type values_;
+    mutable shared_package_manifest manifest_;
+    mutable std::exception_ptr error_;
+  };
+
+  class LIBBPKG_EXPORT lazy_pkg_package_manifests:
+    public std::vector<lazy_package_manifest>
+  {
+  public:
+    using base_type = std::vector<lazy_package_manifest>;
+
+    using base_type::base_type;
+
+    // Checksum of the corresponding repository_manifests.
+    //
+    std::string sha256sum;
+
+  public:
+    lazy_pkg_package_manifests () = default;
+    lazy_pkg_package_manifests (butl::manifest_parser&,
+                                bool ignore_unknown = false);
+
+    // As above but allocate the deferred values of all the manifests from
+    // the specified arena (see manifest_arena for details). This way
+    // loading a large package list results in a small number of heap
+    // allocations, and destroying it in a small number of deallocations.
+    //
+    // Note that the arena must outlive the list and the manifests moved out
+    // of it but not their copies, which are allocated from the heap.
+    //
+    lazy_pkg_package_manifests (butl::manifest_parser&,
+                                manifest_arena&,
+                                bool ignore_unknown = false);
+  };
+
+  // Incremental pkg package manifest list reader.
+  //
+  // The package list manifest is parsed on construction and the package
+  // manifests are then parsed one at a time on each call to next(). The
+  // diagnostics are the same as for pkg_package_manifests. Such a reader is
+  // normally used to process large package lists without keeping all the
+  // package manifests in memory.
+  //
+  // For example:
+  //
+  // pkg_package_manifest_reader r (p);
+  //
+  // while (optional<package_manifest> m = r.next ())
+  //   ...
+  //
+  class LIBBPKG_EXPORT pkg_package_manifest_reader
+  {
+  public:
+    // Checksum of the corresponding repository_manifests.
+    //
+    std::string sha256sum;
+
+    // Parse and return the next package manifest or nullopt if there are no
+    // more manifests in the list. Throw manifest_parsing on error.
+    //
+    butl::optional<package_manifest>
+    next ();
+
+  public:
+    pkg_package_manifest_reader (butl::manifest_parser&,
+                                 bool ignore_unknown = false);
+
+  private:
+    butl::manifest_parser& parser_;
+    bool ignore_unknown_;
+    bool end_ = false;
+  };
+
+  // Snapshot of a pkg package manifest list revision, used to detect the
+  // package manifest changes between the revisions (see
+  // diff_pkg_package_manifests() for details).
+  //
+  // For each package manifest in the list the snapshot contains the
+  // package name and version as well as the checksum of the manifest
+  // name/value pairs (with their positions ignored).
+  //
+  struct package_snapshot
+  {
+    package_name name;
+    bpkg::version version;
+    std::string checksum;
+  };
+
+  class LIBBPKG_EXPORT pkg_package_manifests_snapshot:
+    public std::vector<package_snapshot>
+  {
+  public:
+    using base_type = std::vector<package_snapshot>;
+
+    using base_type::base_type;
+
+    // Checksum of the corresponding repository_manifests.
+    //
+    std::string sha256sum;
+
+  public:
+    pkg_package_manifests_snapshot () = default;
+
+    // Create the snapshot of the package manifest list. Note that only the
+    // package list manifest and the package names and versions are parsed
+    // and validated, so the list is assumed to be valid (for example, it is
+    // the previous revision that has already been loaded).
+    //
+    pkg_package_manifests_snapshot (butl::manifest_parser&,
+                                    bool ignore_unknown = false);
+  };
+
+  // Difference between two pkg package manifest list revisions.
+  //
+  struct pkg_package_manifests_diff
+  {
+    // Snapshot of the new revision.
+    //
+    pkg_package_manifests_snapshot snapshot;
+
+    // Package manifests present in the new revision only.
+    //
+    std::vector<package_manifest> added;
+
+    // Package manifests present in both revisions but with different
+    // contents (new revision manifests).
+    //
+    std::vector<package_manifest> changed;
+
+    // Packages present in the old revision only.
+    //
+    std::vector<std::pair<package_name, version>> removed;
+  };
+
+  // Parse the new pkg package manifest list revision and compare it to the
+  // snapshot of the old revision. Only the added and changed package
+  // manifests are parsed completely, with the same validation and
+  // diagnostics as for pkg_package_manifests. The package manifests are
+  // matched by the package name and version and are considered unchanged if
+  // their name/value checksums are equal. Throw manifest_parsing on error.
+  //
+  // Note that the snapshot of the new revision can be used to detect the
+  // changes in the subsequent revision. The initial revision can be loaded
+  // by comparing it to the empty snapshot, in which case all its package
+  // manifests are added ones. To compare two stored revisions, create the
+  // snapshot of the older one first.
+  //
+  // Also note that the package manifest order in the added and changed
+  // lists is the same as in the new revision and in the removed list -- as
+  // in the old revision.
+  //
+  LIBBPKG_EXPORT pkg_package_manifests_diff
+  diff_pkg_package_manifests (const pkg_package_manifests_snapshot& old,
+                              butl::manifest_parser&,
+                              bool ignore_unknown = false);
+
   class LIBBPKG_EXPORT dir_package_manifests:
     public std::vector<package_manifest>
   {
@@ -1687,6 +2861,31 @@ namespace bpkg
     serialize (butl::manifest_serializer&) const;
   };
 
+  // Incremental dir/git package manifest list reader (see
+  // pkg_package_manifest_reader for details).
+  //
+  // Note that to detect the duplicate package manifests, the reader keeps
+  // the locations of the manifests returned so far.
+  //
+  class LIBBPKG_EXPORT dir_package_manifest_reader
+  {
+  public:
+    butl::optional<package_manifest>
+    next ();
+
+  public:
+    dir_package_manifest_reader (butl::manifest_parser&,
+                                 bool ignore_unknown = false);
+
+  private:
+    butl::manifest_parser& parser_;
+    bool ignore_unknown_;
+    butl::manifest_name_value next_; // Start of the next manifest.
+    std::vector<butl::path> locations_;
+  };
+
+  using git_package_manifest_reader = dir_package_manifest_reader;
+
   // Traits class for the repository URL object.
   //
   enum class repository_protocol {file, http, https, git, ssh};
@@ -1890,6 +3089,12 @@ namespace bpkg
     const std::string&
     canonical_name () const noexcept {return canonical_name_;}
 
+    // Canonical name hash, calculated once on construction. It is 0 for the
+    // empty canonical name.
+    //
+    std::size_t
+    canonical_name_hash () const noexcept {return canonical_name_hash_;}
+
     // There are 3 types of locations: remote, local absolute filesystem
     // path and local relative filesystem path. Plus there is the special
     // empty location. The following predicates can be used to determine
@@ -1965,6 +3170,7 @@ namespace bpkg
 
   private:
     std::string canonical_name_;
+    std::size_t canonical_name_hash_ = 0;
     repository_url url_;
     repository_type type_;
   };
@@ -1975,6 +3181,113 @@ namespace bpkg
     return os << l.string ();
   }
 
+  // Hash and equality function objects that identify repository locations
+  // by their canonical names, comparing the precalculated hashes first. For
+  // example:
+  //
+  // std::unordered_set<repository_location,
+  //                    repository_location_hash,
+  //                    repository_location_equal> s;
+  //
+  // Note that all the relative locations (which have no canonical name) are
+  // considered equal.
+  //
+  struct repository_location_hash
+  {
+    std::size_t
+    operator() (const repository_location& l) const noexcept
+    {
+      return l.canonical_name_hash ();
+    }
+  };
+
+  struct repository_location_equal
+  {
+    bool
+    operator() (const repository_location& x,
+                const repository_location& y) const noexcept
+    {
+      return x.canonical_name_hash () == y.canonical_name_hash () &&
+             x.canonical_name () == y.canonical_name ();
+    }
+  };
+
+  // Repository location interning cache.
+  //
+  // Store each distinct (in the canonical name sense) repository location
+  // once and hand out references to the stored locations. The location
+  // strings are also only parsed once per type/local arguments combination.
+  // This way, when loading many repository manifests which normally refer
+  // to the same prerequisite and complement repositories over and over
+  // again, no identical strings are parsed repeatedly and the locations can
+  // be deduplicated and compared by address.
+  //
+  // Note that the location stored first wins. For example, if
+  // https://example.org/1/stable is interned after
+  // http://example.org/1/stable, then the latter is returned, since both
+  // have the same canonical name.
+  //
+  // The location objects stay valid for the lifetime of the cache. Note
+  // that the cache is not thread-safe.
+  //
+  class LIBBPKG_EXPORT repository_location_cache
+  {
+  public:
+    // Parse the location string as repository_location(string, type, local),
+    // unless already parsed with the same arguments, and return the stored
+    // location. Throw std::invalid_argument and std::system_error as the
+    // repository_location constructor.
+    //
+    // Note that the parsing result for an untyped URL is cached regardless
+    // of the current working directory when the local flag is true (see
+    // repository_location for details on guessing the repository type).
+    //
+    const repository_location&
+    intern (const std::string&,
+            const butl::optional<repository_type>& = butl::nullopt,
+            bool local = false);
+
+    // Throw std::invalid_argument if the location is relative.
+    //
+    const repository_location&
+    intern (const repository_location&);
+
+    const repository_location&
+    intern (repository_location&&);
+
+    // Return the number of distinct locations stored.
+    //
+    std::size_t
+    size () const noexcept {return locations_.size ();}
+
+    bool
+    empty () const noexcept {return locations_.empty ();}
+
+    repository_location_cache () = default;
+
+    // Note that the move constructor preserves the references validity.
+    //
+    repository_location_cache (repository_location_cache&&) = default;
+    repository_location_cache (const repository_location_cache&) = delete;
+
+    repository_location_cache&
+    operator= (repository_location_cache&&) = default;
+
+    repository_location_cache&
+    operator= (const repository_location_cache&) = delete;
+
+  private:
+    std::unordered_set<repository_location,
+                       repository_location_hash,
+                       repository_location_equal> locations_;
+
+    // Parsed location strings keyed by the type argument index: 0 and 1 for
+    // the absent type with the local flag false and true, respectively, and
+    // 2 plus the type value otherwise.
+    //
+    std::unordered_map<std::string, const repository_location*> parsed_[5];
+  };
+
   // Git refname/pattern and/or commit. If none of them is present then the
   // default reference set is assumed. If both are present then the commit is
   // expected to belong to the history of the specified refs (e.g., tag or
@@ -2021,6 +3334,111 @@ namespace bpkg
   LIBBPKG_EXPORT git_ref_filters
   parse_git_ref_filters (const butl::optional<std::string>&);
 
+  // Git reference as advertised by the remote repository (for example, in
+  // the git-ls-remote output).
+  //
+  struct git_ref
+  {
+    std::string name;   // Full refname (refs/tags/v1.2.3, etc).
+    std::string commit; // 40-character commit id.
+  };
+
+  // Git reference filter list compiled for matching against the batches of
+  // references.
+  //
+  // The filters are applied in order with an inclusion filter selecting the
+  // matching references and an exclusion filter deselecting them. As a
+  // result, a reference is selected if the last filter it matches is an
+  // inclusion. A filter matches a reference as follows:
+  //
+  // - The default reference set filter matches the refs/tags/v<version>
+  //   tags where <version> is a standard version.
+  //
+  // - The refname matches the reference with this name, trying it as
+  //   refs/<name>, refs/tags/<name>, and refs/heads/<name>, in this order
+  //   (unless the refname starts with refs/, in which case it is only tried
+  //   as is), with the first one advertised being the match. A pattern (see
+  //   butl::path_match() for details) is matched against the reference name
+  //   with the same prefixes added, if required, and can thus match multiple
+  //   references.
+  //
+  // - The refname that consists of only hexadecimal digits additionally
+  //   matches the references with the commit id it is a prefix of
+  //   (abbreviated commit id).
+  //
+  // - The commit id matches the references with this commit id, unless the
+  //   refname is also specified. In the latter case the commit is expected
+  //   to belong to the history of the matching references, which can only
+  //   be verified by the caller, and so only the refname is matched.
+  //
+  // Note that matching a batch is linear in the number of references, plus
+  // their number times the number of the patterns and abbreviated commit
+  // ids in the filter list.
+  //
+  class LIBBPKG_EXPORT git_ref_filter_matcher
+  {
+  public:
+    explicit
+    git_ref_filter_matcher (const git_ref_filters&);
+
+    struct result
+    {
+      // Selection flag for each reference, in the reference list order.
+      //
+      std::vector<bool> refs;
+
+      // Commit ids of the inclusion filters with only commit specified that
+      // are not advertised by any reference and need to be fetched
+      // explicitly, in the filter list order. A commit is omitted if the
+      // last such filter for it is an exclusion.
+      //
+      std::vector<std::string> commits;
+    };
+
+    result
+    match (const std::vector<git_ref>&) const;
+
+  private:
+    // Filter index in the list and the exclusion flag.
+    //
+    struct filter
+    {
+      std::size_t index;
+      bool exclusion;
+    };
+
+    // Refnames keyed by the candidate reference names. The candidate
+    // position (0 for refs/<name>, etc) is used to pick the first advertised
+    // candidate.
+    //
+    struct name_candidate
+    {
+      std::size_t name;     // Index in names_.
+      std::size_t position;
+    };
+
+    std::vector<filter> names_;
+    std::unordered_map<std::string,
+                       butl::small_vector<name_candidate, 1>> candidates_;
+
+    // Patterns with the prefixes added, if required.
+    //
+    std::vector<std::pair<filter,
+                          butl::small_vector<std::string, 3>>> patterns_;
+
+    std::vector<std::pair<filter, std::string>> abbreviated_;
+
+    // Commit ids of the filters with only commit specified along with the
+    // last such filter for each commit id, ordered by the filter index.
+    //
+    std::vector<std::pair<filter, std::string>> commits_;
+    std::unordered_map<std::string, std::size_t> commit_indexes_;
+
+    // The last default reference set filter, if any.
+    //
+    butl::optional<filter> default_refs_;
+  };
+
   enum class repository_role
   {
     base,
@@ -2177,6 +3595,167 @@ namespace bpkg
     serialize (butl::manifest_serializer&) const;
   };
 
+  // Repository manifest list text (normally the repositories.manifest file
+  // contents) and its name used for diagnostics. The text is not copied and
+  // must stay valid while it is parsed.
+  //
+  struct repository_manifests_text
+  {
+    std::string name;
+    const char* data;
+    std::size_t size;
+  };
+
+  // Parse multiple repository manifest lists (for example, of the
+  // repositories fetched by a mirror) using up to the specified number of
+  // threads (0 means the hardware concurrency). The resulting lists are in
+  // the input order.
+  //
+  // If the errors argument is NULL, then throw the exception for the first
+  // (in the input order) invalid manifest list, as for the sequential
+  // parsing. Otherwise, parse all the lists, save the exceptions for the
+  // invalid ones in the corresponding errors elements (NULL for the valid
+  // ones), and leave the corresponding resulting lists empty.
+  //
+  // Note that the manifest parsing statistics, if enabled, is only collected
+  // for the calling thread and so in this case the lists are parsed
+  // sequentially (see manifest_parsing_stats for details).
+  //
+  LIBBPKG_EXPORT std::vector<pkg_repository_manifests>
+  parse_pkg_repository_manifests (
+    const std::vector<repository_manifests_text>&,
+    bool ignore_unknown = false,
+    std::size_t jobs = 0,
+    std::vector<std::exception_ptr>* errors = nullptr);
+
+  LIBBPKG_EXPORT std::vector<dir_repository_manifests>
+  parse_dir_repository_manifests (
+    const std::vector<repository_manifests_text>&,
+    bool ignore_unknown = false,
+    std::size_t jobs = 0,
+    std::vector<std::exception_ptr>* errors = nullptr);
+
+  LIBBPKG_EXPORT std::vector<git_repository_manifests>
+  parse_git_repository_manifests (
+    const std::vector<repository_manifests_text>&,
+    bool ignore_unknown = false,
+    std::size_t jobs = 0,
+    std::vector<std::exception_ptr>* errors = nullptr);
+
+  // Repository graph.
+  //
+  // The graph nodes are the distinct (in the canonical name sense)
+  // repositories as well as the prerequisite and complement repositories
+  // they refer to. The graph edges go from the repository to its
+  // prerequisite and complement repositories. There is at most one edge of
+  // each kind between any two nodes. As for the package graph, the edges are
+  // stored in the compressed sparse row form and the nodes are ordered by
+  // the canonical name (see package_graph for details).
+  //
+  class LIBBPKG_EXPORT repository_graph
+  {
+  public:
+    using node_type = std::size_t;
+
+    struct edge
+    {
+      node_type node;
+      repository_role role; // Prerequisite or complement.
+    };
+
+    using edges_type = std::vector<edge>;
+    using iterator = edges_type::const_iterator;
+
+    struct range
+    {
+      iterator b;
+      iterator e;
+
+      iterator
+      begin () const {return b;}
+
+      iterator
+      end () const {return e;}
+
+      bool
+      empty () const {return b == e;}
+
+      std::size_t
+      size () const {return static_cast<std::size_t> (e - b);}
+    };
+
+    // Repository location and its repositories manifest list (pkg, dir, or
+    // git).
+    //
+    struct repository
+    {
+      repository_location location;
+      const std::vector<repository_manifest>* manifests;
+    };
+
+    repository_graph () = default;
+
+    // Complete the relative prerequisite and complement repository
+    // locations using the repository location as a base. Throw
+    // std::invalid_argument if any repository location is empty or relative,
+    // as well as if any prerequisite or complement location is empty or
+    // can't be completed.
+    //
+    explicit
+    repository_graph (const std::vector<repository>&);
+
+    // Return the number of nodes.
+    //
+    std::size_t
+    size () const noexcept {return locations_.size ();}
+
+    bool
+    empty () const noexcept {return locations_.empty ();}
+
+    // Note: the node must be less than size().
+    //
+    const repository_location&
+    location (node_type n) const {return *locations_[n];}
+
+    butl::optional<node_type>
+    find (const std::string& canonical_name) const;
+
+    butl::optional<node_type>
+    find (const repository_location& l) const
+    {
+      return find (l.canonical_name ());
+    }
+
+    // Return the repositories the repository refers to.
+    //
+    range
+    dependencies (node_type) const;
+
+    // Return the repositories that refer to the repository, with the edge
+    // role being the same as for the corresponding dependencies() edge.
+    //
+    range
+    dependents (node_type) const;
+
+    // Return the repositories reachable from the specified repository via
+    // the complement and, optionally, prerequisite edges, including the
+    // repository itself. The nodes are returned in the (breadth-first)
+    // traversal order.
+    //
+    std::vector<node_type>
+    reachable (node_type, bool prerequisites = true) const;
+
+  private:
+    repository_location_cache cache_;
+    std::vector<const repository_location*> locations_;
+
+    edges_type dependencies_;
+    std::vector<std::size_t> dependency_offsets_;
+
+    edges_type dependents_;
+    std::vector<std::size_t> dependent_offsets_;
+  };
+
   // Search a repository manifest list for the base repository and return its
   // reference, if found. Otherwise, return a reference to an empty manifest
   // instance (which is the representation of the default base).
@@ -2247,6 +3826,72 @@ namespace bpkg
   {
     return extract_package_version (s.c_str (), fl);
   }
+
+  // Split the package archive or directory name in the <name>-<version>
+  // form (with the archive extension, if any, already stripped) and return
+  // the name component length or 0 if the version component is not found.
+  // The version component follows the name component and the dash
+  // separator. Note that the components are not verified and nothing is
+  // allocated, so this function can be used to quickly filter directory
+  // entries, etc.
+  //
+  // Note also that the version component is assumed to start after the
+  // first dash that is followed by a digit or an epoch ('+' followed by a
+  // digit). Thus, the package names that contain such a sequence (for
+  // example, foo-2bar) are not supported.
+  //
+  LIBBPKG_EXPORT std::size_t
+  split_package_name_version (const char*, std::size_t) noexcept;
+
+  // Extract the package name and version from the package archive or
+  // directory name (see split_package_name_version() for details). Throw
+  // invalid_argument on parsing error and for the earliest and stub
+  // versions.
+  //
+  LIBBPKG_EXPORT std::pair<package_name, version>
+  extract_package_name_version (
+    const char*,
+    std::size_t,
+    version::flags = version::fold_zero_revision);
+
+  // As above but intern the version in the pool. This way, when extracting
+  // many names (for example, while scanning a package cache), the distinct
+  // version strings are parsed only once and the identical versions are
+  // shared.
+  //
+  LIBBPKG_EXPORT std::pair<package_name, version_handle>
+  extract_package_name_version (
+    const char*,
+    std::size_t,
+    version_pool&,
+    version::flags = version::fold_zero_revision);
+}
+
+namespace std
+{
+  template <>
+  struct hash<bpkg::version_key>
+  {
+    size_t
+    operator() (const bpkg::version_key& k) const noexcept
+    {
+      return k.hash ();
+    }
+  };
+
+  // Note that the version hash is consistent with version::operator==() and
+  // needs to create the version sort key. Consider using version_key
+  // directly if the version is hashed repeatedly.
+  //
+  template <>
+  struct hash<bpkg::version>
+  {
+    size_t
+    operator() (const bpkg::version& v) const
+    {
+      return v.compare_key ().hash ();
+    }
+  };
 }
 
 #include <libbpkg/manifest.ixx>
@@ -1,6 +1,7 @@
 // file      : libbpkg/manifest.ixx -*- C++ -*-
 // license   : MIT; see accompanying LICENSE file
 
+#include <cstring>   // memcmp()
 #include <stdexcept> // logic_error
 
 namespace bpkg
@@ -67,6 +68,20 @@ namespace bpkg
     return compare (v) != 0;
   }
 
+  // version_key
+  //
+  inline int version_key::
+  compare (const version_key& k) const noexcept
+  {
+    std::size_t n (data_.size ());
+    std::size_t kn (k.data_.size ());
+
+    if (int r = std::memcmp (data_.data (), k.data_.data (), n < kn ? n : kn))
+      return r;
+
+    return n < kn ? -1 : n > kn ? 1 : 0;
+  }
+
   inline version::flags
   operator&= (version::flags& x, version::flags y)
   {
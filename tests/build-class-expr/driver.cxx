@@ -16,7 +16,7 @@
 // Usages:
 //
 // argv[0] -p
-// argv[0] [<class>[:<base>]]*
+// argv[0] [-c] [<class>[:<base>]]*
 //
 // Parse stdin lines as build configuration class expressions and print them
 // or evaluate.
@@ -29,6 +29,10 @@
 // combined expression, making the underlying class set a starting set for the
 // original expression and a restricting set, simultaneously.
 //
+// -c
+//    Compile the expressions against the universe of the configuration
+//    classes and their bases and match the compiled expressions instead.
+//
 // On error print the exception description to stderr and exit with the two
 // status. Otherwise, if the combined expression doesn't match then exit with
 // the one status. Otherwise, exit with zero status.
@@ -46,6 +50,8 @@ main (int argc, char* argv[])
 
   assert (!print || argc == 2);
 
+  bool compile (argc != 1 && argv[1] == string ("-c"));
+
   cin.exceptions (ios::badbit);
 
   strings cs;
@@ -55,7 +61,7 @@ main (int argc, char* argv[])
     cout.exceptions (ios::failbit | ios::badbit);
   else
   {
-    for (int i (1); i != argc; ++i)
+    for (int i (compile ? 2 : 1); i != argc; ++i)
     {
       string c (argv[i]);
 
@@ -75,6 +81,18 @@ main (int argc, char* argv[])
 
   try
   {
+    build_class_universe u (cs, im);
+    build_class_set ucs (u.classes (cs));
+
+    auto match = [compile, &cs, &im, &u, &ucs] (const build_class_expr& e,
+                                                 bool& r)
+    {
+      if (compile)
+        compiled_build_class_expr (e, u).match (ucs, r);
+      else
+        e.match (cs, im, r);
+    };
+
     string s;
     bool r (false);
     optional<strings> underlying_cls;
@@ -94,18 +112,18 @@ main (int argc, char* argv[])
           if (!underlying_cls->empty ())
           {
             build_class_expr expr (*underlying_cls, '+', "" /* comment */);
-            expr.match (cs, im, r);
+            match (expr, r);
           }
         }
 
-        expr.match (cs, im, r);
+        match (expr, r);
       }
     }
 
     if (underlying_cls && !underlying_cls->empty ())
     {
       build_class_expr expr (*underlying_cls, '&', "" /* comment */);
-      expr.match (cs, im, r);
+      match (expr, r);
     }
 
     return print || r ? 0 : 1;
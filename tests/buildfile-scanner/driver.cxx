@@ -4,6 +4,7 @@
 #include <ios>      // ios_base::failbit, ios_base::badbit
 #include <string>
 #include <iostream>
+#include <iterator> // istreambuf_iterator
 
 #include <libbutl/utf8.hxx>
 #include <libbutl/utility.hxx>      // operator<<(ostream,exception)
@@ -20,13 +21,14 @@ using namespace bpkg;
 
 // Usages:
 //
-// argv[0] (-e|-l [<char>]|-b)
+// argv[0] (-e|-l [<char>]|-b) [-m]
 //
 // Read and scan the buildfile from stdin and print the scan result to stdout.
 //
 // -e          scan evaluation context
 // -l [<char>] scan single line, optionally terminated with the stop character
 // -b          scan buildfile block
+// -m          read stdin into a buffer and scan it with the buffer scanner
 //
 int
 main (int argc, char* argv[])
@@ -35,9 +37,89 @@ main (int argc, char* argv[])
 
   string mode (argv[1]);
 
+  bool buffer (argc > 2 && argv[argc - 1] == string ("-m"));
+
+  if (buffer)
+    --argc;
+
   cin.exceptions  (ios_base::failbit | ios_base::badbit);
   cout.exceptions (ios_base::failbit | ios_base::badbit);
 
+  if (buffer)
+  {
+    string b ((istreambuf_iterator<char> (cin)), istreambuf_iterator<char> ());
+
+    string bsn ("stdin");
+    buildfile_buffer_scanner bs (b.data (), b.size (), bsn);
+
+    // Return the current character or '\0' if eos is reached.
+    //
+    auto peek = [&b, &bs] ()
+    {
+      return !bs.eos () ? b[bs.position ()] : '\0';
+    };
+
+    try
+    {
+      string r;
+
+      if (mode == "-e")
+      {
+        assert (peek () == '(');
+        bs.skip ();
+
+        r += '(';
+        r += bs.scan_eval ();
+
+        assert (peek () == ')');
+        bs.skip ();
+
+        r += ')';
+      }
+      else if (mode == "-l")
+      {
+        char stop ('\0');
+
+        if (argc == 3)
+        {
+          const char* chr (argv[2]);
+          assert (chr[0] != '\0' && chr[1] == '\0');
+
+          stop = chr[0];
+        }
+
+        r += bs.scan_line (stop);
+
+        assert (bs.eos ()       ||
+                peek () == '\n' ||
+                (stop != '\0' && peek () == stop));
+      }
+      else if (mode == "-b")
+      {
+        assert (peek () == '{');
+        bs.skip ();
+
+        r += '{';
+        r += bs.scan_block ();
+
+        assert (bs.eos ());
+
+        r += "}\n";
+      }
+      else
+        assert (false);
+
+      cout << r;
+    }
+    catch (const buildfile_scanning& e)
+    {
+      cerr << e << endl;
+      return 1;
+    }
+
+    return 0;
+  }
+
   using scanner = char_scanner<utf8_validator>;
 
   scanner s (cin);
@@ -3,13 +3,19 @@
 
 #include <ios>      // ios_base::failbit, ios_base::badbit
 #include <string>
+#include <vector>
+#include <memory>   // unique_ptr
+#include <fstream>
 #include <iostream>
+#include <iterator> // istreambuf_iterator
 
 #include <libbutl/manifest-parser.hxx>
 #include <libbutl/manifest-serializer.hxx>
 #include <libbutl/standard-version.hxx>
 
 #include <libbpkg/manifest.hxx>
+#include <libbpkg/binary-index.hxx>
+#include <libbpkg/buffer-stream.hxx>
 
 #undef NDEBUG
 #include <cassert>
@@ -20,16 +26,26 @@ using namespace bpkg;
 
 // Usages:
 //
-// argv[0] (-pp|-dp|-gp|-pr|-dr|-gr|-s) [-l]
-// argv[0] -p [-c] [-i] [-l]
+// argv[0] (-pp|-lp|-ip|-dp|-gp|-pr|-dr|-gr|-s) [-l] [-b] [-j <jobs>] [-r]
+//         [-sh] [-cs] [-st] [-a]
+// argv[0] -p [-c] [-i] [-l] [-e] [-st] [-f]
 // argv[0] -ec <version>
 // argv[0] -et <type> <name>
+// argv[0] -ab [<config>/<target>[/<class>]*]*
+// argv[0] -fp <name> [<constraint>]
+// argv[0] -pd <file>
+// argv[0] -ag <name>...
 // argv[0] -v
 //
 // In the first form read and parse manifest list from stdin and serialize it
 // to stdout. The following options specify the manifest type.
 //
 // -pp  parse pkg package manifest list
+// -lp  parse pkg package manifest list lazily, print the package names and
+//      versions (one per line), and then parse the complete manifests
+// -ip  parse pkg package manifest list, produce the binary package index,
+//      print the indexed package names, versions, and locations (one per
+//      line), and then serialize the manifest list restored from the index
 // -dp  parse dir package manifest list
 // -gp  parse git package manifest list
 // -pr  parse pkg repository manifest list
@@ -43,12 +59,48 @@ using namespace bpkg;
 //
 // -c   complete the incomplete values (depends, <distribution>-version, etc)
 // -i   ignore unknown
+// -e   validate the manifest instead, printing all the errors to stderr
+// -st  collect the parsing statistics and print the package value groups
+//      with their counts and sizes to stderr (one per line)
+// -f   load the *-file values in a single batch, reading the files relative
+//      to the current working directory and leaving the values for the
+//      missing files unexpanded, print the value names and file paths passed
+//      to the load function to stderr (one per line)
 //
 // Note: the above options should go after -p on the command line.
 //
 // -l
 //    Don't break long lines while serializing a manifest.
 //
+// -b
+//    Read stdin into a buffer and parse the manifest list from this buffer.
+//    Also serialize the manifest list into a buffer and then write it to
+//    stdout.
+//
+// -j <jobs>
+//    Parse pkg package manifest list using the specified number of threads.
+//
+// -r
+//    Parse pkg, dir, or git package manifest list incrementally, serializing
+//    each package manifest right after it is parsed.
+//
+// -sh
+//    Move the parsed pkg package manifests into the shared manifests and
+//    serialize the manifest list from the shared manifest copies.
+//
+// -cs
+//    Calculate the SHA256 checksum of stdin while parsing the manifest list
+//    and print it to stderr after serializing the list.
+//
+// -st
+//    Collect the parsing statistics and print the number of package
+//    manifests followed by the package value groups with their counts to
+//    stderr (one per line) after serializing the list.
+//
+// -a
+//    Allocate the deferred values of the lazily parsed pkg package manifests
+//    from an arena.
+//
 // In the third form read and parse dependency constraints from stdin and
 // roundtrip them to stdout together with their effective constraints,
 // calculated using version passed as an argument.
@@ -56,7 +108,26 @@ using namespace bpkg;
 // In the forth form print the effective type and the type sub-options to
 // stdout (one per line) and exit.
 //
-// In the fifth form print the libbpkg version to stdout and exit.
+// In the fifth form read and parse the package manifest from stdin and print
+// the allowed package build configuration and target build configuration
+// name pairs (one per line) for the target configurations passed as
+// arguments.
+//
+// In the sixth form read and parse the pkg package manifest list from stdin,
+// index it, and print the versions of the specified package (one per line)
+// optionally satisfying the version constraint, followed by the latest such
+// version prefixed with the '>' character, if present.
+//
+// In the seventh form read and parse the old pkg package manifest list
+// revision from the file and the new one from stdin and print the added,
+// changed, and removed packages (one per line) prefixed with the '+', '*',
+// and '-' characters, respectively.
+//
+// In the eighth form read and parse the pkg package manifest list from stdin,
+// build the package dependency graph, and print the packages affected by a
+// change in the specified packages (one per line).
+//
+// In the ninth form print the libbpkg version to stdout and exit.
 //
 int
 main (int argc, char* argv[])
@@ -81,6 +152,9 @@ main (int argc, char* argv[])
       bool complete_values (false);
       bool ignore_unknown (false);
       bool long_lines (false);
+      bool validate (false);
+      bool stats (false);
+      bool load_files (false);
 
       for (int i (2); i != argc; ++i)
       {
@@ -92,15 +166,38 @@ main (int argc, char* argv[])
           ignore_unknown = true;
         else if (o == "-l")
           long_lines = true;
+        else if (o == "-e")
+          validate = true;
+        else if (o == "-st")
+          stats = true;
+        else if (o == "-f")
+          load_files = true;
         else
           assert (false);
       }
 
+      manifest_parsing_stats st;
+      unique_ptr<manifest_parsing_stats_guard> sg (
+        stats ? new manifest_parsing_stats_guard (st) : nullptr);
+
+      if (validate)
+      {
+        cin.exceptions (ios_base::failbit | ios_base::badbit);
+
+        vector<manifest_parsing> es (
+          package_manifest::validate (p, ignore_unknown, complete_values));
+
+        for (const manifest_parsing& e: es)
+          cerr << e << endl;
+
+        return es.empty () ? 0 : 1;
+      }
+
       manifest_serializer s (cout, "stdout", long_lines);
 
       cin.exceptions (ios_base::failbit | ios_base::badbit);
 
-      package_manifest (
+      package_manifest m (
         p,
         [] (version& v)
         {
@@ -118,7 +215,47 @@ main (int argc, char* argv[])
           }
         },
         ignore_unknown,
-        complete_values).serialize (s);
+        complete_values);
+
+      if (load_files)
+      {
+        m.load_files (
+          [] (const vector<pair<string, path>>& fs)
+          {
+            vector<butl::optional<string>> r;
+
+            for (const pair<string, path>& f: fs)
+            {
+              cerr << f.first << ' ' << f.second.posix_string () << endl;
+
+              ifstream ifs (f.second.string ());
+
+              if (ifs.is_open ())
+              {
+                ifs.exceptions (ios_base::badbit);
+
+                r.emplace_back (string (istreambuf_iterator<char> (ifs),
+                                        istreambuf_iterator<char> ()));
+              }
+              else
+                r.emplace_back (butl::nullopt);
+            }
+
+            return r;
+          },
+          ignore_unknown);
+      }
+
+      m.serialize (s);
+
+      if (stats)
+      {
+        assert (st.package_manifests.count == 1);
+
+        for (const auto& v: st.package_values)
+          cerr << v.first << ' ' << v.second.count << ' ' << v.second.bytes
+               << endl;
+      }
     }
     else if (mode == "-ec")
     {
@@ -139,6 +276,138 @@ main (int argc, char* argv[])
         cout << c << " " << ec << endl;
       }
     }
+    else if (mode == "-ab")
+    {
+      vector<build_target_config> tcs;
+
+      for (int i (2); i != argc; ++i)
+      {
+        string a (argv[i]);
+        strings vs;
+
+        for (size_t b (0), e (0); e != string::npos; b = e + 1)
+        {
+          e = a.find ('/', b);
+          vs.push_back (string (a, b, e != string::npos ? e - b : e));
+        }
+
+        assert (vs.size () >= 2);
+
+        tcs.push_back (build_target_config {
+            move (vs[0]), move (vs[1]), strings (vs.begin () + 2, vs.end ())});
+      }
+
+      cin.exceptions (ios_base::failbit | ios_base::badbit);
+
+      package_manifest m (p);
+
+      for (const pair<size_t, size_t>& b:
+             allowed_builds (m, tcs, build_class_inheritance_map ()))
+        cout << m.build_configs[b.first].name << ' ' << tcs[b.second].name
+             << endl;
+    }
+    else if (mode == "-fp")
+    {
+      assert (argc == 3 || argc == 4);
+
+      package_name n (argv[2]);
+
+      optional<version_constraint> c;
+      if (argc == 4)
+        c = version_constraint (argv[3]);
+
+      cin.exceptions (ios_base::failbit | ios_base::badbit);
+
+      pkg_package_manifests ms (p);
+      package_index ix (ms);
+
+      assert (ix.size () == ms.size ());
+
+      for (const package_manifest* m: c ? ix.find (n, *c) : ix.find (n))
+        cout << m->version << endl;
+
+      if (const package_manifest* m = ix.find_latest (n, c))
+        cout << '>' << m->version << endl;
+    }
+    else if (mode == "-pd")
+    {
+      assert (argc == 3);
+
+      ifstream ifs (argv[2]);
+      ifs.exceptions (ios_base::failbit | ios_base::badbit);
+
+      manifest_parser fp (ifs, argv[2]);
+      pkg_package_manifests_snapshot ss (fp);
+
+      cin.exceptions (ios_base::failbit | ios_base::badbit);
+
+      string b ((istreambuf_iterator<char> (cin)),
+                istreambuf_iterator<char> ());
+
+      auto diff = [&b] (const pkg_package_manifests_snapshot& ss)
+      {
+        ibufferstream is (b.data (), b.size ());
+        is.exceptions (ios_base::failbit | ios_base::badbit);
+
+        manifest_parser p (is, "stdin");
+        return diff_pkg_package_manifests (ss, p);
+      };
+
+      pkg_package_manifests_diff d (diff (ss));
+
+      for (const package_manifest& m: d.added)
+        cout << "+ " << m.name << '/' << m.version << endl;
+
+      for (const package_manifest& m: d.changed)
+        cout << "* " << m.name << '/' << m.version << endl;
+
+      for (const pair<package_name, version>& p: d.removed)
+        cout << "- " << p.first << '/' << p.second << endl;
+
+      // Make sure that the list is unchanged compared to its own snapshot.
+      //
+      pkg_package_manifests_diff e (diff (d.snapshot));
+
+      assert (e.added.empty () && e.changed.empty () && e.removed.empty ());
+      assert (e.snapshot.size () == d.snapshot.size ());
+    }
+    else if (mode == "-ag")
+    {
+      assert (argc >= 3);
+
+      cin.exceptions (ios_base::failbit | ios_base::badbit);
+
+      pkg_package_manifests ms (p);
+      package_graph g (ms);
+
+      // Make sure the dependents are the reversed dependencies.
+      //
+      for (size_t n (0); n != g.size (); ++n)
+      {
+        for (const package_graph::edge& d: g.dependencies (n))
+        {
+          bool found (false);
+          for (const package_graph::edge& e: g.dependents (d.node))
+          {
+            if (e.node == n && e.type == d.type)
+              found = true;
+          }
+
+          assert (found);
+        }
+      }
+
+      vector<package_graph::node_type> ns;
+      for (int i (2); i != argc; ++i)
+      {
+        optional<package_graph::node_type> n (g.find (package_name (argv[i])));
+        assert (n);
+        ns.push_back (*n);
+      }
+
+      for (package_graph::node_type n: g.affected (ns))
+        cout << g.name (n) << endl;
+    }
     else if (mode == "-et")
     {
       assert (argc == 4);
@@ -157,6 +426,13 @@ main (int argc, char* argv[])
     else
     {
       bool long_lines (false);
+      bool buffer (false);
+      bool reader (false);
+      bool shared (false);
+      bool checksum (false);
+      bool stats (false);
+      bool arena (false);
+      optional<size_t> jobs;
 
       for (int i (2); i != argc; ++i)
       {
@@ -164,30 +440,190 @@ main (int argc, char* argv[])
 
         if (o == "-l")
           long_lines = true;
+        else if (o == "-b")
+          buffer = true;
+        else if (o == "-r")
+          reader = true;
+        else if (o == "-sh")
+          shared = true;
+        else if (o == "-cs")
+          checksum = true;
+        else if (o == "-st")
+          stats = true;
+        else if (o == "-a")
+          arena = true;
+        else if (o == "-j")
+        {
+          assert (i + 1 != argc);
+          jobs = stoul (argv[++i]);
+        }
         else
           assert (false);
       }
 
-      manifest_serializer s (cout, "stdout", long_lines);
+      manifest_parsing_stats st;
+      unique_ptr<manifest_parsing_stats_guard> sg (
+        stats ? new manifest_parsing_stats_guard (st) : nullptr);
+
+      string ob;
+      obufferstream os (ob);
+      os.exceptions (ios_base::failbit | ios_base::badbit);
+
+      manifest_serializer s (buffer ? static_cast<ostream&> (os) : cout,
+                             "stdout",
+                             long_lines);
 
       cin.exceptions (ios_base::failbit | ios_base::badbit);
 
-      if (mode == "-pp")
-        pkg_package_manifests (p).serialize (s);
+      string b;
+      if (buffer)
+        b.assign (istreambuf_iterator<char> (cin),
+                  istreambuf_iterator<char> ());
+
+      ibufferstream is (b.data (), b.size ());
+      is.exceptions (ios_base::failbit | ios_base::badbit);
+
+      manifest_parser bp (is, "stdin");
+
+      assert (!buffer || !checksum);
+
+      isha256stream cs (cin);
+      cs.exceptions (ios_base::failbit | ios_base::badbit);
+
+      manifest_parser cp (cs, "stdin");
+
+      manifest_parser& mp (buffer ? bp : checksum ? cp : p);
+
+      if (reader)
+      {
+        if (mode == "-pp")
+        {
+          pkg_package_manifest_reader r (mp);
+
+          s.next ("", "1"); // Start of manifest.
+          s.next ("sha256sum", r.sha256sum);
+          s.next ("", "");  // End of manifest.
+
+          while (optional<package_manifest> m = r.next ())
+            pkg_package_manifest (s, *m);
+        }
+        else if (mode == "-dp" || mode == "-gp")
+        {
+          dir_package_manifest_reader r (mp);
+
+          while (optional<package_manifest> m = r.next ())
+            dir_package_manifest (s, *m);
+        }
+        else
+          assert (false);
+
+        s.next ("", ""); // End of stream.
+      }
+      else if (mode == "-pp" && shared)
+      {
+        pkg_package_manifests ms (mp);
+
+        shared_package_manifests sms (
+          make_shared_package_manifests (move (ms)));
+
+        shared_package_manifests cms (sms);
+
+        s.next ("", "1"); // Start of manifest.
+        s.next ("sha256sum", ms.sha256sum);
+        s.next ("", "");  // End of manifest.
+
+        for (size_t i (0); i != cms.size (); ++i)
+        {
+          assert (cms[i] == sms[i] && sms[i].use_count () == 2);
+          pkg_package_manifest (s, *cms[i]);
+        }
+
+        s.next ("", ""); // End of stream.
+      }
+      else if (mode == "-pp")
+      {
+        (jobs
+         ? pkg_package_manifests (mp, false /* ignore_unknown */, *jobs)
+         : pkg_package_manifests (mp)).serialize (s);
+      }
+      else if (mode == "-lp")
+      {
+        manifest_arena a;
+        lazy_pkg_package_manifests ms (arena
+                                       ? lazy_pkg_package_manifests (mp, a)
+                                       : lazy_pkg_package_manifests (mp));
+
+        for (const lazy_package_manifest& m: ms)
+          cout << m.name << '/' << m.version << endl;
+
+        pkg_package_manifests r;
+        r.sha256sum = move (ms.sha256sum);
+
+        for (const lazy_package_manifest& m: ms)
+          r.push_back (m.manifest ());
+
+        r.serialize (s);
+      }
+      else if (mode == "-ip")
+      {
+        const string ss (64, '0');
+
+        string d (serialize_binary_package_index (pkg_package_manifests (mp),
+                                                  ss));
+
+        // Make sure a truncated index is detected.
+        //
+        try
+        {
+          binary_package_index (d.data (), d.size () - 1);
+          assert (false);
+        }
+        catch (const invalid_argument&) {}
+
+        binary_package_index ix (d.data (), d.size ());
+        assert (ix.source_sha256sum ().compare (ss) == 0);
+
+        for (size_t i (0); i != ix.size (); ++i)
+        {
+          binary_package_index::package p (ix[i]);
+
+          cout << p.name.string () << '/' << p.version.string () << ' '
+               << p.location.string () << endl;
+        }
+
+        ix.manifests ().serialize (s);
+      }
       else if (mode == "-dp")
-        dir_package_manifests (p).serialize (s);
+        dir_package_manifests (mp).serialize (s);
       else if (mode == "-gp")
-        git_package_manifests (p).serialize (s);
+        git_package_manifests (mp).serialize (s);
       else if (mode == "-pr")
-        pkg_repository_manifests (p).serialize (s);
+        pkg_repository_manifests (mp).serialize (s);
       else if (mode == "-dr")
-        dir_repository_manifests (p).serialize (s);
+        dir_repository_manifests (mp).serialize (s);
       else if (mode == "-gr")
-        git_repository_manifests (p).serialize (s);
+        git_repository_manifests (mp).serialize (s);
       else if (mode == "-s")
-        signature_manifest (p).serialize (s);
+        signature_manifest (mp).serialize (s);
       else
         assert (false);
+
+      if (buffer)
+      {
+        os.flush ();
+        cout << ob;
+      }
+
+      if (checksum)
+        cerr << cs.checksum () << endl;
+
+      if (stats)
+      {
+        cerr << "package-manifests " << st.package_manifests.count << endl;
+
+        for (const auto& v: st.package_values)
+          cerr << v.first << ' ' << v.second.count << endl;
+      }
     }
   }
   catch (const manifest_parsing& e)
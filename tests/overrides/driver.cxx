@@ -6,6 +6,7 @@
 #include <vector>
 #include <cstddef>  // size_t
 #include <cstdint>  // uint64_t
+#include <sstream>
 #include <iostream>
 
 #include <libbutl/utility.hxx>             // trim()
@@ -78,7 +79,47 @@ main (int argc, char* argv[])
   try
   {
     package_manifest m (p);
-    m.override (overrides, name);
+
+    // While at it, test package_manifest_overrides, making sure that the
+    // overrides fail or succeed the same way and, in the latter case,
+    // produce the same manifest.
+    //
+    package_manifest cm (m);
+    bool cf (false);
+
+    try
+    {
+      package_manifest_overrides (overrides, name).apply (cm);
+    }
+    catch (const manifest_parsing&)
+    {
+      cf = true;
+    }
+
+    try
+    {
+      m.override (overrides, name);
+    }
+    catch (const manifest_parsing&)
+    {
+      assert (cf);
+      throw;
+    }
+
+    assert (!cf);
+
+    {
+      ostringstream os1;
+      ostringstream os2;
+
+      manifest_serializer s1 (os1, "stdout");
+      manifest_serializer s2 (os2, "stdout");
+
+      m.serialize (s1);
+      cm.serialize (s2);
+
+      assert (os1.str () == os2.str ());
+    }
 
     // While at it, test validate_overrides().
     //
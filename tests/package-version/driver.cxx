@@ -2,10 +2,11 @@
 // license   : MIT; see accompanying LICENSE file
 
 #include <string>
-#include <cstdint>   // uint16
+#include <cstdint>    // uint16
+#include <functional> // hash
 #include <iostream>
 #include <exception>
-#include <stdexcept> // invalid_argument
+#include <stdexcept>  // invalid_argument
 
 #include <libbutl/utility.hxx>  // operator<<(ostream, exception)
 #include <libbutl/optional.hxx>
@@ -421,6 +422,301 @@ namespace bpkg
 
       assert (version ("1.1.1-a.0.1+2#34", version::flags::allow_iteration) ==
               version (1, "1.1.1", string ("a.0.1"), 2, 34));
+
+      // Test the version sort key.
+      //
+      {
+        const version vs[] = {
+          version (),
+          version ("0"),
+          version ("0+1"),
+          version ("a"),
+          version ("aa"),
+          version ("a.a"),
+          version ("a.1"),
+          version ("a.1b"),
+          version ("1-"),
+          version ("1-1"),
+          version ("1-alpha"),
+          version ("1"),
+          version ("1+0", version::none),
+          version ("1+1"),
+          version ("1.0.1"),
+          version ("1.1.1a+1"),
+          version ("12"),
+          version ("+2-0.1"),
+          version (1, "2.0", nullopt, 3, 4),
+          version (1, "2.0", nullopt, 3, 5),
+          version (1, "2.0", nullopt, nullopt, 1)};
+
+        auto sign = [] (int r) {return r < 0 ? -1 : r > 0 ? 1 : 0;};
+
+        for (const version& x: vs)
+        {
+          for (const version& y: vs)
+          {
+            for (bool ir: {false, true})
+            {
+              for (bool ii: {false, true})
+              {
+                version_key kx (x.compare_key (ir, ii));
+                version_key ky (y.compare_key (ir, ii));
+
+                int r (sign (x.compare (y, ir, ii)));
+
+                assert (sign (kx.compare (ky)) == r);
+                assert ((kx == ky) == (r == 0));
+
+                if (r == 0)
+                  assert (kx.hash () == ky.hash ());
+              }
+            }
+          }
+        }
+
+        assert (hash<version> () (version ("1.0")) ==
+                hash<version> () (version ("1")));
+      }
+
+      // Test the compact version representation.
+      //
+      {
+        const version vs[] = {
+          version (),
+          version ("0"),
+          version ("0-"),
+          version ("1-"),
+          version ("1-alpha"),
+          version ("1.Alpha.1"),
+          version ("1"),
+          version ("1+0", version::none),
+          version ("1+1"),
+          version ("+2-0.1"),
+          version (1, "2.0", nullopt, 3, 4),
+          version (1, "2.0", nullopt, 3, 5),
+          version (1, "2.0", nullopt, nullopt, 1)};
+
+        auto sign = [] (int r) {return r < 0 ? -1 : r > 0 ? 1 : 0;};
+
+        for (const version& x: vs)
+        {
+          compact_version cx (x);
+
+          assert (cx.empty () == x.empty ());
+          assert (cx.empty () == (cx.capacity () == 0));
+          assert (cx.epoch () == x.epoch);
+          assert (cx.upstream () == x.upstream);
+          assert (cx.release () == x.release);
+          assert (cx.revision () == x.revision);
+          assert (cx.iteration () == x.iteration);
+          assert (cx.canonical_upstream () == x.canonical_upstream);
+          assert (cx.canonical_release () == x.canonical_release);
+          assert (version (cx) == x);
+
+          if (!x.empty ())
+            assert (cx.string () == x.string ());
+
+          compact_version c (cx);
+          assert (c == cx);
+
+          c = move (cx);
+          assert (cx.empty () && version (c) == x);
+
+          for (const version& y: vs)
+          {
+            compact_version cy (y);
+
+            for (bool ir: {false, true})
+            {
+              for (bool ii: {false, true})
+                assert (sign (c.compare (cy, ir, ii)) ==
+                        sign (x.compare (y, ir, ii)));
+            }
+          }
+        }
+
+        assert (compact_version ("1.2.3") == compact_version ("1.2.3.0"));
+        assert (compact_version ("1.2.3") < compact_version ("1.2.4"));
+      }
+
+      // Test the version pool.
+      //
+      {
+        version_pool p;
+
+        version_handle h1 (p.intern ("1.2.3"));
+        version_handle h2 (p.intern ("1.2.3"));
+        version_handle h3 (p.intern ("+1-1.2.3"));
+        version_handle h4 (p.intern (version ("1.2.3.0")));
+        version_handle h5 (p.intern ("1.2.3+0", version::none));
+        version_handle h6 (p.intern ("1.2.4"));
+        version_handle h7 (p.intern (version ()));
+
+        assert (h1.get () == h2.get ());
+        assert (h1.get () == h3.get ());
+        assert (h1.get () != h4.get () && h1 == h4);
+        assert (h1.get () != h5.get () && h1 < h5);
+        assert (h1.compare (h5, true /* ignore_revision */) == 0);
+        assert (h1 < h6 && h7 < h1);
+        assert (h7->empty () && (*h1).string () == "1.2.3");
+        assert (p.size () == 5);
+
+        assert (!version_handle ());
+        assert (p.intern ("1.2.3-") < h1);
+
+        try
+        {
+          p.intern ("1.2.3+a");
+          assert (false);
+        }
+        catch (const invalid_argument&) {}
+
+        assert (p.size () == 6);
+      }
+
+      // Test the version constraint operations.
+      //
+      {
+        using vc = version_constraint;
+
+        auto sat = [] (const char* v, const char* c)
+        {
+          return satisfies (version (v, version::allow_iteration), vc (c));
+        };
+
+        assert (sat ("1.2.3", "^1.2.0"));
+        assert (!sat ("2.0.0", "^1.2.0"));
+        assert (!sat ("2.0.0-a.1", "^1.2.0"));
+        assert (sat ("1.2.0+3", "== 1.2.0"));
+        assert (!sat ("1.2.0+3", "== 1.2.0+2"));
+        assert (sat ("1.2.0+3#2", "== 1.2.0+3"));
+        assert (!sat ("1.2.0+3", "(1.2.0 1.3.0)"));
+        assert (sat ("1.2.0+3", "(1.2.0+2 1.3.0)"));
+        assert (sat ("1.0.0", "< 1.2.0"));
+        assert (!sat ("1.2.0", "< 1.2.0"));
+        assert (sat ("1.2.0", "[1.2.0+0 1.3.0)"));
+        assert (sat ("1.2.0", "== 1.2.0+0"));
+        assert (sat ("1.2.0+0", "== 1.2.0+0"));
+        assert (!sat ("1.2.0", "(1.2.0+0 1.3.0)"));
+        assert (sat ("1.2.0+1", "(1.2.0+0 1.3.0)"));
+        assert (!sat ("1.2.0", "< 1.2.0+0"));
+        assert (sat ("1.2.0", "<= 1.2.0+0"));
+
+        auto isect = [] (const char* x, const char* y) -> string
+        {
+          optional<vc> r (intersect (vc (x), vc (y)));
+          return r ? r->string () : "";
+        };
+
+        assert (isect ("^1.2.0", "~1.3.0") == "~1.3.0");
+        assert (isect ("^1.2.0", ">= 1.5.0") == "^1.5.0");
+        assert (isect ("< 2.0.0", ">= 1.0.0") == "[1.0.0 2.0.0)");
+        assert (isect ("< 2.0.0", "< 1.0.0") == "< 1.0.0");
+        assert (isect ("== 1.2.0", "^1.0.0") == "== 1.2.0");
+        assert (isect ("(1.2.0+0 1.3.0)", "[1.2.0+1 1.2.0]") ==
+                "(1.2.0+0 1.2.0]");
+        assert (isect ("^1.2.0", "^2.0.0") == "");
+        assert (isect ("< 1.2.0", "== 1.2.0") == "");
+        assert (isect ("(1.2.0+1 1.3.0)", "[1.0.0 1.2.0+2)") == "");
+        assert (isect ("(1.2.0 1.3.0)", "<= 1.2.0") == "");
+        assert (isect ("[1.2.0+0 1.3.0)", "<= 1.2.0") == "[1.2.0+0 1.2.0]");
+        assert (isect ("== 1.2.0+0", ">= 1.2.0") == "== 1.2.0+0");
+        assert (isect ("(1.2.0+0 1.3.0)", "< 1.2.0+1") == "");
+        assert (isect ("[1.2.0+0 1.3.0)", "< 1.2.0") == "");
+
+        auto subs = [] (const char* x, const char* y)
+        {
+          return subsumes (vc (x), vc (y));
+        };
+
+        assert (subs ("^1.0.0", "~1.2.0"));
+        assert (!subs ("~1.2.0", "^1.0.0"));
+        assert (subs ("== 1.2.0", "== 1.2.0+1"));
+        assert (!subs ("== 1.2.0+1", "== 1.2.0"));
+        assert (subs ("(1.2.0+1 1.3.0)", "[1.2.0+2 1.3.0)"));
+        assert (subs ("[1.2.0+2 1.3.0)", "(1.2.0+1 1.3.0)"));
+        assert (subs (">= 1.0.0", "[1.0.0 2.0.0)"));
+        assert (!subs ("[1.0.0 2.0.0)", ">= 1.0.0"));
+        assert (subs ("[1.2.0 1.3.0)", "[1.2.0+0 1.3.0)"));
+        assert (subs ("[1.2.0+0 1.3.0)", "[1.2.0 1.3.0)"));
+        assert (subs ("== 1.2.0", "== 1.2.0+0"));
+        assert (!subs ("== 1.2.0+0", "== 1.2.0"));
+      }
+
+      // Package archive and directory names.
+      //
+      {
+        auto split = [] (const string& s) -> string
+        {
+          size_t n (split_package_name_version (s.c_str (), s.size ()));
+          return n != 0 ? string (s, 0, n) + ' ' + string (s, n + 1) : "";
+        };
+
+        assert (split ("libfoo-1.2.0") == "libfoo 1.2.0");
+        assert (split ("libfoo-bar-1.2.0-a.1+2") == "libfoo-bar 1.2.0-a.1+2");
+        assert (split ("libstdc++-+1-2.0.0") == "libstdc++ +1-2.0.0");
+        assert (split ("libfoo2-3") == "libfoo2 3");
+        assert (split ("libfoo") == "");
+        assert (split ("libfoo-") == "");
+        assert (split ("libfoo-bar") == "");
+        assert (split ("libfoo-+") == "");
+        assert (split ("-1.2.0") == "");
+        assert (split ("") == "");
+
+        auto extract = [] (const string& s)
+        {
+          return extract_package_name_version (s.c_str (), s.size ());
+        };
+
+        {
+          pair<package_name, version> r (extract ("libfoo-1.2.0+1"));
+          assert (r.first.string () == "libfoo" &&
+                  r.second == version ("1.2.0+1"));
+        }
+
+        try
+        {
+          extract ("libfoo-1.2.0+a");
+          assert (false);
+        }
+        catch (const invalid_argument&) {} // Invalid version.
+
+        try
+        {
+          extract ("libfoo-1.2.0-");
+          assert (false);
+        }
+        catch (const invalid_argument&) {} // Earliest version.
+
+        try
+        {
+          extract ("libfoo-0");
+          assert (false);
+        }
+        catch (const invalid_argument&) {} // Stub version.
+
+        try
+        {
+          extract ("libfoo");
+          assert (false);
+        }
+        catch (const invalid_argument&) {} // No version.
+
+        version_pool p;
+
+        string f ("libfoo-1.2.0");
+        string b ("libbar-1.2.0");
+
+        pair<package_name, version_handle> x (
+          extract_package_name_version (f.c_str (), f.size (), p));
+
+        pair<package_name, version_handle> y (
+          extract_package_name_version (b.c_str (), b.size (), p));
+
+        assert (x.first.string () == "libfoo");
+        assert (y.first.string () == "libbar");
+        assert (x.second.get () == y.second.get () && p.size () == 1);
+      }
     }
     catch (const exception& e)
     {
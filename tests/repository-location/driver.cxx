@@ -3,7 +3,9 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 #include <iostream>
+#include <exception> // exception_ptr
 #include <stdexcept> // invalid_argument, logic_error
 
 #include <libbutl/optional.hxx>
@@ -920,6 +922,65 @@ namespace bpkg
               git_ref_filters ({git_ref_filter ("a"), git_ref_filter ("b")}));
     }
 
+    // git_ref_filter_matcher
+    //
+    {
+      string c1 ("0a53e9ddeaddad63ad106860237bbf53411d11a7");
+      string c2 ("1b53e9ddeaddad63ad106860237bbf53411d11a7");
+      string c3 ("2c53e9ddeaddad63ad106860237bbf53411d11a7");
+      string c4 ("3d53e9ddeaddad63ad106860237bbf53411d11a7");
+
+      const vector<git_ref> rs ({
+          {"refs/heads/master", c1},
+          {"refs/heads/stable", c2},
+          {"refs/tags/stable", c3},
+          {"refs/tags/v1.0.0", c2},
+          {"refs/tags/v1.1.0", c3},
+          {"refs/tags/release", c4},
+          {"refs/heads/feature/foo", c4},
+          {"refs/heads/feature/bar", c4}});
+
+      auto match_filters = [&rs] (const git_ref_filters& fs)
+      {
+        git_ref_filter_matcher::result r (
+          git_ref_filter_matcher (fs).match (rs));
+
+        string s;
+        for (size_t i (0); i != r.refs.size (); ++i)
+          s += r.refs[i] ? '1' : '0';
+
+        for (const string& c: r.commits)
+          s += ' ' + string (c, 0, 2);
+
+        return s;
+      };
+
+      auto match = [&match_filters] (const string& fs)
+      {
+        return match_filters (parse_git_ref_filters (fs));
+      };
+
+      assert (match_filters (parse_git_ref_filters (nullopt)) == "00011000");
+      assert (match ("master") == "10000000");
+      assert (match ("stable") == "00100000");       // Tag is found first.
+      assert (match ("heads/stable") == "01000000");
+      assert (match ("refs/heads/stable") == "01000000");
+      assert (match ("feature/*") == "00000011");
+      assert (match ("feature/*,-feature/bar") == "00000010");
+      assert (match ("-feature/bar,feature/*") == "00000011");
+      assert (match ("#,-v1.0.0") == "00001000");
+      assert (match ("3d53") == "00000111");         // Abbreviated commit.
+      assert (match ('@' + c2) == "01010000");
+      assert (match ("master@" + c2) == "10000000");
+      assert (match ("tags/*,-@" + c3) == "00010100");
+
+      string u ("4e53e9ddeaddad63ad106860237bbf53411d11a7");
+
+      assert (match ('@' + u) == "00000000 4e");
+      assert (match ('@' + u + ",-@" + u) == "00000000");
+      assert (match ("-@" + u + ",@" + u) == "00000000 4e");
+    }
+
     // repository_url
     //
     assert (repository_url ("git://example.com/test.git") ==
@@ -963,6 +1024,188 @@ namespace bpkg
     assert (repository_url ("c:/a/").string () == "c:\\a");
 #endif
 
+    // repository_location_cache
+    //
+    {
+      assert (loc ().canonical_name_hash () == 0);
+      assert (loc ("1/aa/bb", loc ()).canonical_name_hash () == 0);
+
+      repository_location l1 (loc ("http://www.example.com/1/stable"));
+      repository_location l2 (loc ("https://example.com/1/stable"));
+      repository_location l3 (loc ("http://example.com/1/testing"));
+
+      assert (l1.canonical_name_hash () != 0);
+      assert (l1.canonical_name_hash () == l2.canonical_name_hash ());
+
+      repository_location_hash h;
+      repository_location_equal eq;
+
+      assert (h (l1) == h (l2) && eq (l1, l2));
+      assert (!eq (l1, l3));
+
+      repository_location_cache c;
+
+      const repository_location& r1 (
+        c.intern ("http://www.example.com/1/stable"));
+
+      assert (&c.intern ("http://www.example.com/1/stable") == &r1);
+      assert (&c.intern (l2) == &r1);
+      assert (r1.string () == l1.string ());
+
+      const repository_location& r3 (c.intern (move (l3)));
+      assert (&r3 != &r1 && r3.canonical_name () == "pkg:example.com/testing");
+
+      const repository_location& r4 (
+        c.intern ("https://example.com/1/testing", repository_type::pkg));
+
+      assert (&r4 == &r3 && c.size () == 2);
+
+      assert (&c.intern ("https://git.example.com/repo.git#master") !=
+              &c.intern ("https://git.example.com/repo.git#stable"));
+
+      assert (c.size () == 4);
+
+      try
+      {
+        c.intern (loc ("1/aa/bb", loc ()));
+        assert (false);
+      }
+      catch (const invalid_argument&) {}
+
+      try
+      {
+        c.intern ("git+https://example.com/repo", repository_type::pkg);
+        assert (false);
+      }
+      catch (const invalid_argument&) {}
+
+      assert (c.size () == 4);
+    }
+
+    // repository_graph
+    //
+    {
+      auto rm = [] (repository_location l, repository_role r)
+      {
+        repository_manifest m;
+        m.location = move (l);
+        m.role = r;
+        return m;
+      };
+
+      using role = repository_role;
+
+      // Note that the relative locations are completed using the repository
+      // location as a base.
+      //
+      pkg_repository_manifests stable ({
+          repository_manifest (),
+          rm (loc ("../testing", loc ()), role::complement),
+          rm (loc ("https://example.org/1/math"), role::prerequisite)});
+
+      pkg_repository_manifests testing ({
+          rm (loc ("http://www.example.com/1/stable"), role::prerequisite)});
+
+      pkg_repository_manifests math ({
+          rm (loc ("https://example.org/1/misc"), role::complement)});
+
+      repository_graph g ({
+          {loc ("https://example.com/1/stable"), &stable},
+          {loc ("https://example.com/1/testing"), &testing},
+          {loc ("https://example.org/1/math"), &math}});
+
+      assert (g.size () == 4);
+
+      optional<size_t> s (g.find ("pkg:example.com/stable"));
+      optional<size_t> t (g.find (loc ("https://example.com/1/testing")));
+      optional<size_t> m (g.find ("pkg:example.org/math"));
+      optional<size_t> x (g.find ("pkg:example.org/misc"));
+
+      assert (s && t && m && x);
+      assert (!g.find ("pkg:example.org/stable"));
+
+      assert (g.location (*s).string () == "https://example.com/1/stable");
+
+      assert (g.dependencies (*s).size () == 2);
+      assert (g.dependencies (*x).empty ());
+      assert (g.dependents (*s).size () == 1);
+
+      const repository_graph::edge& e (*g.dependents (*s).begin ());
+      assert (e.node == *t && e.role == role::prerequisite);
+
+      assert (g.reachable (*s) ==
+              vector<size_t> ({*s, *t, *m, *x}));
+
+      assert (g.reachable (*s, false /* prerequisites */) ==
+              vector<size_t> ({*s, *t}));
+
+      assert (g.reachable (*x) == vector<size_t> ({*x}));
+
+      try
+      {
+        repository_graph ({{loc ("1/aa/bb", loc ()), &stable}});
+        assert (false);
+      }
+      catch (const invalid_argument&) {}
+    }
+
+    // parse_*_repository_manifests()
+    //
+    {
+      string stable (": 1\nsummary: The stable repository\n");
+
+      string testing (": 1\n"
+                      "location: https://example.org/1/math\n"
+                      "role: prerequisite\n"
+                      ":\n"
+                      "summary: The testing repository\n");
+
+      string bad (": 1\nsummary: The bad repository\nfoo: bar\n");
+
+      auto text = [] (const string& n, const string& t)
+      {
+        return repository_manifests_text {n, t.c_str (), t.size ()};
+      };
+
+      vector<pkg_repository_manifests> rs (
+        parse_pkg_repository_manifests ({text ("stable", stable),
+                                         text ("testing", testing)},
+                                        false /* ignore_unknown */,
+                                        2 /* jobs */));
+
+      assert (rs.size () == 2);
+      assert (rs[0].size () == 1 && rs[1].size () == 2);
+      assert (rs[1][0].location.string () == "https://example.org/1/math");
+      assert (*rs[1][1].summary == "The testing repository");
+
+      vector<repository_manifests_text> ts ({text ("stable", stable),
+                                             text ("bad", bad),
+                                             text ("bad2", bad),
+                                             text ("testing", testing)});
+
+      try
+      {
+        parse_pkg_repository_manifests (ts, false, 4);
+        assert (false);
+      }
+      catch (const manifest_parsing& e)
+      {
+        assert (e.name == "bad" && e.line == 3 && e.column == 1);
+      }
+
+      assert (parse_pkg_repository_manifests (ts, true, 4).size () == 4);
+
+      vector<exception_ptr> es;
+      rs = parse_pkg_repository_manifests (ts, false, 4, &es);
+
+      assert (es.size () == 4);
+      assert (es[0] == nullptr && es[3] == nullptr);
+      assert (es[1] != nullptr && es[2] != nullptr);
+      assert (rs[1].empty () && rs[3].size () == 2);
+
+      assert (parse_git_repository_manifests ({}).empty ());
+    }
+
     return 0;
   }
 }